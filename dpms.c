@@ -0,0 +1,98 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * dpms.c: tells whether the screens are powered down, so that nothing is
+ *         animated for nobody. i3lock does not drive DPMS itself (see the
+ *         manpage), it only watches what xset or the like set up.
+ *
+ */
+#include <config.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <xcb/xcb.h>
+#include <xcb/dpms.h>
+
+#include "i3lock.h"
+#include "xcb.h"
+#include "dpms.h"
+
+extern bool debug_mode;
+
+static bool has_dpms = false;
+static bool has_events = false;
+#ifdef HAVE_DPMS_INFO_NOTIFY
+static uint8_t dpms_opcode;
+#endif
+
+bool dpms_init(void) {
+    const xcb_query_extension_reply_t *extreply = xcb_get_extension_data(conn, &xcb_dpms_id);
+    if (extreply == NULL || !extreply->present) {
+        DEBUG("DPMS is not present, animating even while the screens are off.\n");
+        return false;
+    }
+
+    xcb_generic_error_t *err;
+    xcb_dpms_get_version_reply_t *dpms_version =
+        xcb_dpms_get_version_reply(
+            conn, xcb_dpms_get_version(conn, XCB_DPMS_MAJOR_VERSION, XCB_DPMS_MINOR_VERSION), &err);
+    if (err != NULL) {
+        DEBUG("Could not query DPMS version: X11 error code %d\n", err->error_code);
+        free(err);
+        return false;
+    }
+    has_dpms = true;
+
+#ifdef HAVE_DPMS_INFO_NOTIFY
+    /* InfoNotify came with DPMS 1.2. */
+    has_events = (dpms_version->server_major_version > 1) ||
+                 (dpms_version->server_major_version == 1 && dpms_version->server_minor_version >= 2);
+    if (has_events) {
+        xcb_dpms_select_input(conn, XCB_DPMS_EVENT_MASK_INFO_NOTIFY);
+        dpms_opcode = extreply->major_opcode;
+    }
+#endif
+    free(dpms_version);
+
+    DEBUG("DPMS %s\n", has_events ? "sends InfoNotify events" : "has to be polled");
+    return true;
+}
+
+bool dpms_has_events(void) {
+    return has_events;
+}
+
+static bool power_level_off(uint8_t state, uint16_t power_level) {
+    return state && power_level != XCB_DPMS_DPMS_MODE_ON;
+}
+
+bool dpms_screen_off(void) {
+    if (!has_dpms) {
+        return false;
+    }
+    xcb_dpms_info_reply_t *info = xcb_dpms_info_reply(conn, xcb_dpms_info(conn), NULL);
+    if (info == NULL) {
+        return false;
+    }
+    const bool off = power_level_off(info->state, info->power_level);
+    free(info);
+    return off;
+}
+
+bool dpms_handle_event(xcb_generic_event_t *event, bool *off) {
+#ifndef HAVE_DPMS_INFO_NOTIFY
+    return false;
+#else
+    if (!has_events || (event->response_type & 0x7F) != XCB_GE_GENERIC) {
+        return false;
+    }
+    xcb_ge_generic_event_t *generic = (xcb_ge_generic_event_t *)event;
+    if (generic->extension != dpms_opcode || generic->event_type != XCB_DPMS_INFO_NOTIFY) {
+        return false;
+    }
+    xcb_dpms_info_notify_event_t *info = (xcb_dpms_info_notify_event_t *)event;
+    *off = power_level_off(info->state, info->power_level);
+    return true;
+#endif
+}
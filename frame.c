@@ -0,0 +1,363 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * frame.c: composes a frame out of the game of life, the image and the
+ *          unlock indicator onto a cairo surface, keeping track of what
+ *          changed. It knows nothing about X11: the surface may as well be
+ *          an image surface.
+ *
+ */
+#include <stdbool.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+
+#include "frame.h"
+#include "frame_stats.h"
+#include "gol.h"
+#include "indicator.h"
+#include "render.h"
+
+void frame_init(struct frame *frame, cairo_surface_t *surface, int width, int height) {
+    memset(frame, 0, sizeof(struct frame));
+    frame->width = width;
+    frame->height = height;
+    frame->surface = cairo_surface_reference(surface);
+    frame->ctx = cairo_create(frame->surface);
+}
+
+void frame_init_buffer(struct frame *frame, const struct render_buffer *buffer) {
+    cairo_surface_t *surface = cairo_image_surface_create_for_data((unsigned char *)buffer->pixels,
+                                                                   CAIRO_FORMAT_RGB24,
+                                                                   buffer->width, buffer->height,
+                                                                   buffer->stride * sizeof(uint32_t));
+    frame_init(frame, surface, buffer->width, buffer->height);
+    cairo_surface_destroy(surface);
+    frame->buffer = *buffer;
+}
+
+void frame_free(struct frame *frame) {
+    if (frame->indicator_surface != NULL) {
+        cairo_destroy(frame->indicator_ctx);
+        cairo_surface_destroy(frame->indicator_surface);
+    }
+    cairo_destroy(frame->ctx);
+    cairo_surface_destroy(frame->surface);
+    free(frame->damage);
+    free(frame->generations);
+    memset(frame, 0, sizeof(struct frame));
+}
+
+static void add_damage(struct frame *frame, int x, int y, int width, int height) {
+    int x1 = x + width;
+    int y1 = y + height;
+    x = (x < 0 ? 0 : x);
+    y = (y < 0 ? 0 : y);
+    x1 = (x1 > frame->width ? frame->width : x1);
+    y1 = (y1 > frame->height ? frame->height : y1);
+    if (x >= x1 || y >= y1) {
+        return;
+    }
+
+    if (frame->damage_len == frame->damage_size) {
+        frame->damage_size = (frame->damage_size == 0 ? 64 : 2 * frame->damage_size);
+        frame->damage = realloc(frame->damage, frame->damage_size * sizeof(struct frame_rect));
+        if (frame->damage == NULL) {
+            err(EXIT_FAILURE, "realloc");
+        }
+    }
+    frame->damage[frame->damage_len++] = (struct frame_rect){x, y, x1 - x, y1 - y};
+}
+
+static void set_source_pixel(cairo_t *ctx, uint32_t pixel) {
+    cairo_set_source_rgb(ctx,
+                         ((pixel >> 16) & 0xFF) / 255.0,
+                         ((pixel >> 8) & 0xFF) / 255.0,
+                         (pixel & 0xFF) / 255.0);
+}
+
+/* Fills the current path with the image (-i), if any. */
+static void fill_img(cairo_t *ctx, const struct frame_scene *scene) {
+    if (!scene->tile) {
+        cairo_set_source_surface(ctx, scene->img, 0, 0);
+        cairo_fill(ctx);
+    } else {
+        /* create a pattern and fill with it */
+        cairo_pattern_t *pattern;
+        pattern = cairo_pattern_create_for_surface(scene->img);
+        cairo_set_source(ctx, pattern);
+        cairo_pattern_set_extend(pattern, CAIRO_EXTEND_REPEAT);
+        cairo_fill(ctx);
+        cairo_pattern_destroy(pattern);
+    }
+}
+
+/* Whether the rectangle is within the screen of one grid, so that no
+ * background shows between the screens. */
+static bool covered_by_grid(const struct frame_scene *scene, int x, int y, int width, int height) {
+    for (int i = 0; i < scene->nlife; i++) {
+        const struct render_grid *life = &scene->life[i];
+        if (x >= life->x && y >= life->y &&
+            x + width <= life->x + life->width && y + height <= life->y + life->height) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Adds the live cells of a grid within the given rectangle to the current
+ * path. */
+static void trace_live_cells(cairo_t *ctx, const struct render_grid *life, int x, int y, int width, int height) {
+    const int grid = life->size;
+    x -= life->x;
+    y -= life->y;
+    int col_first = (x > 0 ? x / grid : 0);
+    int row_first = (y > 0 ? y / grid : 0);
+    int col_end = (x + width + grid - 1) / grid;
+    int row_end = (y + height + grid - 1) / grid;
+    if (col_end > life->cols) {
+        col_end = life->cols;
+    }
+    if (row_end > life->rows) {
+        row_end = life->rows;
+    }
+    gol_select(life->screen);
+    for (int row = row_first; row < row_end; row++) {
+        for (int col = col_first; col < col_end; col++) {
+            if (!gol_cell_is_alive(col, row)) {
+                continue;
+            }
+            const int start = col;
+            while (col + 1 < col_end && gol_cell_is_alive(col + 1, row)) {
+                col++;
+            }
+            cairo_rectangle(ctx, life->x + (grid * start), life->y + (grid * row), grid * (col - start + 1), grid);
+        }
+    }
+}
+
+/* Paints the background, the live cells and the image within the given
+ * rectangle of the frame. Each screen shows its own grid, anything in
+ * between only the background of the first. */
+static void paint_life(struct frame *frame, const struct frame_scene *scene, int x, int y, int width, int height) {
+    cairo_t *ctx = frame->ctx;
+    const bool gaps = !covered_by_grid(scene, x, y, width, height);
+    cairo_save(ctx);
+    cairo_rectangle(ctx, x, y, width, height);
+    cairo_clip(ctx);
+
+    if (frame->buffer.pixels != NULL) {
+        cairo_surface_flush(frame->surface);
+        if (gaps) {
+            render_fill_rect(&frame->buffer, x, y, width, height, scene->life[0].background);
+        }
+        for (int i = 0; i < scene->nlife; i++) {
+            render_life(&frame->buffer, &scene->life[i], x, y, width, height);
+        }
+        cairo_surface_mark_dirty_rectangle(frame->surface, x, y, width, height);
+    } else {
+        if (gaps) {
+            set_source_pixel(ctx, scene->life[0].background);
+            cairo_paint(ctx);
+        }
+        for (int i = 0; i < scene->nlife; i++) {
+            const struct render_grid *life = &scene->life[i];
+            cairo_save(ctx);
+            cairo_rectangle(ctx, life->x, life->y, life->width, life->height);
+            cairo_clip(ctx);
+            set_source_pixel(ctx, life->background);
+            cairo_paint(ctx);
+            trace_live_cells(ctx, life, x, y, width, height);
+            set_source_pixel(ctx, life->foreground);
+            cairo_fill(ctx);
+            cairo_restore(ctx);
+        }
+    }
+
+    if (scene->img) {
+        cairo_rectangle(ctx, x, y, width, height);
+        fill_img(ctx, scene);
+    }
+    cairo_restore(ctx);
+}
+
+enum cell_filter { CELLS_DEAD, CELLS_ALIVE, CELLS_ANY };
+
+/* Adds the cells that changed in the last generation to the current path,
+ * merging horizontal runs of neighbouring cells into one rectangle. */
+static void trace_changed_cells(cairo_t *ctx, const struct render_grid *life, enum cell_filter filter) {
+    const int grid = life->size;
+    gol_select(life->screen);
+    for (int row = 0; row < life->rows; row++) {
+        int col = gol_next_changed(0, row);
+        while (col != -1) {
+            const bool alive = gol_cell_is_alive(col, row);
+            int end = col + 1;
+            int next;
+            while ((next = gol_next_changed(end, row)) == end &&
+                   (filter == CELLS_ANY || gol_cell_is_alive(end, row) == alive)) {
+                end++;
+            }
+            if (filter == CELLS_ANY || alive == (filter == CELLS_ALIVE)) {
+                cairo_rectangle(ctx, life->x + (grid * col), life->y + (grid * row), grid * (end - col), grid);
+            }
+            col = next;
+        }
+    }
+}
+
+/* Repaints the cells that changed in the last generation. */
+static void paint_changed_cells(struct frame *frame, const struct frame_scene *scene, const struct render_grid *life) {
+    cairo_t *ctx = frame->ctx;
+    if (frame->buffer.pixels != NULL) {
+        cairo_surface_flush(frame->surface);
+        render_changed_cells(&frame->buffer, life);
+        cairo_surface_mark_dirty(frame->surface);
+    } else {
+        trace_changed_cells(ctx, life, CELLS_DEAD);
+        set_source_pixel(ctx, life->background);
+        cairo_fill(ctx);
+        trace_changed_cells(ctx, life, CELLS_ALIVE);
+        set_source_pixel(ctx, life->foreground);
+        cairo_fill(ctx);
+    }
+    if (scene->img) {
+        trace_changed_cells(ctx, life, CELLS_ANY);
+        fill_img(ctx, scene);
+    }
+}
+
+/* The last column on the given row whose cell changed in the last
+ * generation, looking from the end a word at a time. */
+static int last_changed(const struct render_grid *life, int row) {
+    const uint64_t *cells = gol_line(row);
+    const uint64_t *before = gol_line_before(row);
+    for (int w = (life->cols - 1) / 64; w >= 0; w--) {
+        const uint64_t diff = cells[w] ^ before[w];
+        if (diff != 0 && gol_tile_changed(w * 64, row)) {
+            return (w * 64) + 63 - __builtin_clzll(diff);
+        }
+    }
+    return -1;
+}
+
+/* Adds the cells that changed in the last generation to the damage, as
+ * rectangles spanning consecutive changed rows. */
+static void damage_changed_cells(struct frame *frame, const struct render_grid *life) {
+    const int grid = life->size;
+    gol_select(life->screen);
+    int first_row = -1;
+    int first_col = 0;
+    int last_col = 0;
+    for (int row = 0; row <= life->rows; row++) {
+        int col = (row < life->rows ? gol_next_changed(0, row) : -1);
+        if (col == -1) {
+            if (first_row != -1) {
+                add_damage(frame, life->x + (grid * first_col), life->y + (grid * first_row),
+                           grid * (last_col - first_col + 1), grid * (row - first_row));
+                first_row = -1;
+            }
+            continue;
+        }
+        if (first_row == -1) {
+            first_row = row;
+            first_col = col;
+            last_col = col;
+        }
+        if (col < first_col) {
+            first_col = col;
+        }
+        col = last_changed(life, row);
+        if (col > last_col) {
+            last_col = col;
+        }
+    }
+}
+
+/*
+ * The indicator is rendered once and composited onto the middle of every
+ * screen, over the life beneath it, which is repainted first. The same goes
+ * for an indicator that is gone.
+ *
+ */
+void frame_draw(struct frame *frame, const struct frame_scene *scene) {
+    const int diameter = indicator_diameter(scene->scaling_factor);
+    if (frame->indicator_surface == NULL || frame->indicator_diameter != diameter) {
+        if (frame->indicator_surface != NULL) {
+            cairo_destroy(frame->indicator_ctx);
+            cairo_surface_destroy(frame->indicator_surface);
+        }
+        frame->indicator_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, diameter, diameter);
+        frame->indicator_ctx = cairo_create(frame->indicator_surface);
+        frame->indicator_diameter = diameter;
+        /* The last indicator may have been bigger than this one. */
+        frame->drawn = false;
+    }
+
+    const double start = frame_stats_now();
+    frame->damage_len = 0;
+    if (frame->ngenerations != scene->nlife) {
+        frame->generations = realloc(frame->generations, scene->nlife * sizeof(unsigned long));
+        if (frame->generations == NULL && scene->nlife > 0) {
+            err(EXIT_FAILURE, "realloc");
+        }
+        frame->ngenerations = scene->nlife;
+        frame->drawn = false;
+    }
+    if (!frame->drawn) {
+        /* A new surface: paint everything. */
+        paint_life(frame, scene, 0, 0, frame->width, frame->height);
+        add_damage(frame, 0, 0, frame->width, frame->height);
+    }
+    /* Every game is read on its own, they need not be at the same
+     * generation. */
+    for (int i = 0; i < scene->nlife; i++) {
+        const struct render_grid *life = &scene->life[i];
+        gol_select(life->screen);
+        const unsigned long generation = gol_generation();
+        if (frame->drawn && generation != frame->generations[i]) {
+            if (generation != frame->generations[i] + gol_step()) {
+                /* The surface fell behind this game: paint all of it. */
+                paint_life(frame, scene, life->x, life->y, life->width, life->height);
+                add_damage(frame, life->x, life->y, life->width, life->height);
+            } else {
+                // draw life, only the cells that changed
+                paint_changed_cells(frame, scene, life);
+                damage_changed_cells(frame, life);
+            }
+        }
+        frame->generations[i] = generation;
+    }
+    frame->drawn = true;
+    const double life_end = frame_stats_now();
+
+    const bool indicator = (scene->indicator != NULL || frame->indicator);
+    if (scene->indicator != NULL) {
+        draw_indicator(frame->indicator_ctx, scene->scaling_factor, scene->indicator);
+    }
+    if (indicator) {
+        for (int screen = 0; screen < scene->nscreens; screen++) {
+            const struct frame_rect *r = &scene->screens[screen];
+            int x = r->x + ((r->width / 2) - (diameter / 2));
+            int y = r->y + ((r->height / 2) - (diameter / 2));
+            paint_life(frame, scene, x, y, diameter, diameter);
+            if (scene->indicator != NULL) {
+                cairo_set_source_surface(frame->ctx, frame->indicator_surface, x, y);
+                cairo_rectangle(frame->ctx, x, y, diameter, diameter);
+                cairo_fill(frame->ctx);
+            }
+            add_damage(frame, x, y, diameter, diameter);
+        }
+    }
+    frame->indicator = (scene->indicator != NULL);
+    const double indicator_end = frame_stats_now();
+
+    /* Make sure everything reached the surface before it is presented. */
+    cairo_surface_flush(frame->surface);
+
+    frame_stats_record(FRAME_STAGE_RASTERIZE, (life_end - start) + (frame_stats_now() - indicator_end));
+    if (indicator) {
+        frame_stats_record(FRAME_STAGE_INDICATOR, indicator_end - life_end);
+    }
+}
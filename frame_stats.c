@@ -0,0 +1,162 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * frame_stats.c: times the stages of every frame into fixed-bucket
+ *                histograms, so a slow lock screen can tell where its time
+ *                goes without the cost of keeping every sample.
+ *
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "frame_stats.h"
+
+/* Buckets are in microseconds: one per microsecond below
+ * HISTOGRAM_SUB_BUCKETS, then HISTOGRAM_SUB_BUCKETS per power of two, so a
+ * bucket is never wider than 1/HISTOGRAM_SUB_BUCKETS of what it holds. The
+ * last bucket takes everything from about a minute on. */
+#define HISTOGRAM_SUB_BUCKETS 8
+#define HISTOGRAM_OCTAVES 24
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS * HISTOGRAM_OCTAVES)
+
+struct histogram {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t samples;
+    double sum;
+    double max;
+};
+
+static const char *stage_names[FRAME_STAGE_COUNT] = {
+    [FRAME_STAGE_SIMULATE] = "simulate",
+    [FRAME_STAGE_DETECT] = "detect",
+    [FRAME_STAGE_RASTERIZE] = "rasterize",
+    [FRAME_STAGE_INDICATOR] = "indicator",
+    [FRAME_STAGE_PRESENT] = "present",
+};
+
+static struct {
+    struct histogram stages[FRAME_STAGE_COUNT];
+    struct histogram frames;
+    double period;
+    double last_start;
+    uint64_t late;
+    uint64_t dropped;
+    /* Frames drawn onto the background pixmap and frames sent to the X
+     * server, for spotting duplicated work. */
+    uint64_t rendered;
+    uint64_t presented;
+} stats;
+
+double frame_stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+void frame_stats_set_period(double period) {
+    stats.period = period;
+}
+
+static int bucket_of(double seconds) {
+    const uint64_t us = (seconds > 0 ? (uint64_t)(seconds * 1e6) : 0);
+    if (us < HISTOGRAM_SUB_BUCKETS) {
+        return us;
+    }
+    const int msb = 63 - __builtin_clzll(us);
+    const int shift = msb - 3;
+    const int bucket = (shift + 1) * HISTOGRAM_SUB_BUCKETS + (int)((us >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+    return (bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1);
+}
+
+/* The end of a bucket, in seconds. */
+static double bucket_end(int bucket) {
+    bucket++;
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        return bucket / 1e6;
+    }
+    const int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    const uint64_t us = (uint64_t)(HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << shift;
+    return us / 1e6;
+}
+
+static void histogram_add(struct histogram *h, double seconds) {
+    h->counts[bucket_of(seconds)]++;
+    h->samples++;
+    h->sum += seconds;
+    if (seconds > h->max) {
+        h->max = seconds;
+    }
+}
+
+/* The end of the bucket holding the given percentile, capped by the largest
+ * sample. */
+static double histogram_percentile(const struct histogram *h, double p) {
+    const uint64_t rank = (uint64_t)(p / 100.0 * h->samples + 0.999999);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        seen += h->counts[bucket];
+        if (seen >= rank) {
+            const double end = bucket_end(bucket);
+            return (end < h->max ? end : h->max);
+        }
+    }
+    return h->max;
+}
+
+void frame_stats_record(enum frame_stage stage, double seconds) {
+    histogram_add(&stats.stages[stage], seconds);
+}
+
+void frame_stats_frame(double start, double end) {
+    histogram_add(&stats.frames, end - start);
+    if (stats.period <= 0) {
+        return;
+    }
+    if (end - start > stats.period) {
+        stats.late++;
+    }
+    if (stats.last_start > 0) {
+        /* Rounded, so that jitter of the timer does not count. */
+        const double periods = (start - stats.last_start) / stats.period;
+        if (periods >= 1.5) {
+            stats.dropped += (uint64_t)(periods + 0.5) - 1;
+        }
+    }
+    stats.last_start = start;
+}
+
+void frame_stats_rendered(void) {
+    stats.rendered++;
+}
+
+void frame_stats_presented(void) {
+    stats.presented++;
+}
+
+void frame_stats_resume(void) {
+    stats.last_start = 0;
+}
+
+static void dump_histogram(FILE *out, const char *name, const struct histogram *h) {
+    if (h->samples == 0) {
+        fprintf(out, "  %-9s      0 samples\n", name);
+        return;
+    }
+    fprintf(out, "  %-9s %6llu samples, mean %8.3f ms, p50 %8.3f ms, p95 %8.3f ms, p99 %8.3f ms, max %8.3f ms\n",
+            name, (unsigned long long)h->samples, h->sum / h->samples * 1e3,
+            histogram_percentile(h, 50) * 1e3, histogram_percentile(h, 95) * 1e3,
+            histogram_percentile(h, 99) * 1e3, h->max * 1e3);
+}
+
+void frame_stats_dump(FILE *out) {
+    fprintf(out, "frame timing: %llu frames, %llu late, %llu dropped (period %.1f ms), %llu rendered, %llu presented\n",
+            (unsigned long long)stats.frames.samples, (unsigned long long)stats.late,
+            (unsigned long long)stats.dropped, stats.period * 1e3, (unsigned long long)stats.rendered,
+            (unsigned long long)stats.presented);
+    for (int stage = 0; stage < FRAME_STAGE_COUNT; stage++) {
+        dump_histogram(out, stage_names[stage], &stats.stages[stage]);
+    }
+    dump_histogram(out, "frame", &stats.frames);
+    fflush(out);
+}
@@ -1,17 +1,169 @@
 #include "gol.h"
+#include "gol_hashlife.h"
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+// Cells are bit-packed, 64 per word. Each row starts on a fresh word, so the
+// last word of a row only uses the low (cell_nh % 64) bits; the rest stays 0.
+// Rows are framed by a ghost word either side, and planes by a ghost row above
+// and below: gol_halo_refresh() copies the opposite edges of the grid into
+// them, so the kernels find the neighbours of edge cells without wrapping.
+struct gol;
+
+// A Life-like rule in B/S notation, compiled into a 2x9 transition table: bit
+// k of born is set when a dead cell with k live neighbours comes to life, bit
+// k of survive when a live one with k live neighbours stays alive.
+struct gol_rule {
+    uint16_t born;
+    uint16_t survive;
+};
+
+#define GOL_RULE_CONWAY "B3/S23"
+
+struct gol_kernel {
+    const char* name;
+    const char* isa;
+    // the rule it is specialized for, in B/S notation, NULL for any rule
+    const char* rule;
+    void (*row)(struct gol* gol, const uint64_t* up, const uint64_t* mid, const uint64_t* down, uint64_t* next,
+                const int first, const int last);
+    // if not NULL, computes the line below mid as well, given the line below
+    // down, in about the time of one
+    void (*lines)(struct gol* gol, const uint64_t* up, const uint64_t* mid, const uint64_t* down,
+                  const uint64_t* below, uint64_t* next, uint64_t* next_below, const int first, const int last);
+};
 
 struct gol {
+    const struct gol_kernel* kernel;
+    struct gol_rule rule;  // applied by the kernel, rules 1-4 for Conway's
     int cell_nh;
     int cell_nv;
-    unsigned int* cell_array;
+    int word_nh;
+    int word_straight;  // words of a row not wrapping east, all but a partial last one
+    int stride;         // words from one row of a plane to the next, ghosts included
+    int age_stride;     // cells from one row of the age plane to the next, whole tiles
+    uint64_t last_mask;
+    uint64_t* cells;      // alive plane of the current generation (front buffer)
+    uint64_t* next;       // alive plane the next generation is computed into (back buffer)
+    uint64_t* explode;    // cells exploding during the current generation (rule 5)
+    bool* line_exploded;  // lines with any bit set in the explode plane
+    uint64_t* zero_row;   // stands in for the explode plane of calm lines
+    double halo_seconds;  // spent in gol_halo_refresh() since gol_init()
+    uint8_t* age;         // generations each live cell has been alive, up to GOL_EXPLODE_AGE
+    bool aging;           // whether rule 5 applies, otherwise age is left alone
+    double density;       // of the initial soup, and of reseeded tiles
+    unsigned long generation;
+
+    // Hash of the current generation, kept up to date when hashing is set.
+    bool hashing;
+    uint64_t hash;
+    double hash_seconds;  // spent updating the hash since gol_init()
+
+    // The grid is also split into tiles, one word wide and GOL_TILE_LINES
+    // lines high, each with GOL_TILE_* flags for the current generation and
+    // for the one being computed.
+    int tile_nv;
+    uint8_t* tiles;
+    uint8_t* next_tiles;
+    unsigned long* tile_solved;  // last generation each tile was computed into
+    unsigned long* tile_wake;    // generation by which each tile must be computed again
+};
+
+// cells of the tile changed in the last generation
+#define GOL_TILE_CHANGED 1
+// cells of the tile differ from two generations ago
+#define GOL_TILE_CHANGED2 2
+// cells of the tile exploded, or were given life by an explosion
+#define GOL_TILE_EXPLODED 4
+
+struct gol_pool;
+
+#define GOL_CACHE_LINE 64
+
+// Its thread writes hash and hash_seconds as it goes, so each band has cache
+// lines of its own.
+struct gol_band {
+    struct gol_pool* pool;
+    int first;
+    int last;
+    uint64_t* row;        // kernel output, before rule 5
+    uint64_t* row_below;  // of the next line, from kernels that compute two
+    bool* active;         // tiles of the current row of tiles that are computed
+    uint64_t hash;        // change of the hash over the band's lines
+    double hash_seconds;
+} __attribute__((aligned(GOL_CACHE_LINE)));
+
+// What the threads of one start of a pool synchronize with. After a fork it
+// still counts the threads that did not survive it, so destroying or setting
+// it up again could block or fail: the threads started then get a new one.
+struct gol_pool_sync {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_barrier_t barrier;
+};
+
+struct gol_pool {
+    struct gol* gol;
+    bool running;
+    int nthreads;
+    int nthreads_wanted;
+    pthread_t* threads;
+    struct gol_band* bands;
+    unsigned long round;
+    // the workers return when they wake up to it
+    bool stopping;
+    struct gol_pool_sync* sync;
 };
 
+#define GOL_CYCLE_HISTORY 64
+
 struct gamectx {
     struct gol gol;
+    struct gol_pool pool;
+    int threads;
+    double density;
+    bool no_explode;
+    // set by gol_set_rule(), Conway's B3/S23 otherwise
+    bool has_rule;
+    struct gol_rule rule;
+    char rule_name[24];
+    // set by gol_set_kernel(), picked for the CPU and rule otherwise
+    const char* kernel;
+    struct {
+        bool enabled;
+        int step_log2;
+        size_t memory_limit;
+        struct gol_hashlife* universe;
+    } hashlife;
+    struct {
+        enum gol_stagnation policy;
+        // hashes of the last GOL_CYCLE_HISTORY updates, the first valid of them
+        uint64_t history[GOL_CYCLE_HISTORY];
+        unsigned long updates;
+        unsigned long valid;
+        // period of the cycle the hashes have been following since update since
+        unsigned long period;
+        unsigned long since;
+        double seconds;
+        // the generations of a confirmed cycle, recorded then replayed
+        struct {
+            unsigned long period;
+            unsigned long recorded;
+            unsigned long index;
+            uint64_t hash;
+            uint64_t* planes;
+            uint8_t* tiles;
+            // the game's own planes and tiles, set aside while replaying
+            uint64_t* cells;
+            uint64_t* next;
+            uint8_t* own_tiles;
+        } replay;
+    } cycle;
     struct {
         int width;
         int height;
@@ -20,38 +172,138 @@ struct gamectx {
         int size;
         int nh;
         int nv;
+        // asked for with gol_set_grid(), 0 when the cell size decides
+        int cols;
+        int rows;
     } grid;
 };
-static struct gamectx _g;
+// One game per screen, the selected one is _g. The settings are made on the
+// first before gol_init_screens(), which keeps them in _settings and starts
+// every game from a copy: gol_init_game() and the games themselves change
+// theirs, and own the planes, pool and universe they allocate.
+#define GOL_MAX_SCREENS 16
+static struct gamectx _games[GOL_MAX_SCREENS];
+static int _ngames = 1;
+static struct gamectx* _g = &_games[0];
+static struct gamectx _settings;
+static bool _initialized = false;
+
+#define GOL_WORD_BITS 64
+// Rows of the planes, and of ages, start on a cache line, so the tiles of one
+// line never share theirs with another line computed by another thread: each
+// row comes after GOL_ROW_PAD words, the last of them its west ghost word.
+// The planes stay row-major rather than stored tile by tile: a line is
+// computed from three rows, under 3 KB even at 8K, which stay in L1 anyway.
+#define GOL_ROW_PAD ((int)(GOL_CACHE_LINE / sizeof(uint64_t)))
+// Ages stop at this, rule 5 cannot tell older cells apart, so they fit a byte.
+#define GOL_EXPLODE_AGE 100
+#define GOL_BAND_MIN_WORDS 4096
+#define GOL_TILE_LINES 32
+#define GOL_HASHLIFE_MEMORY (256UL << 20)
+// cells are GOL_CELL_SIZE pixels wide at GOL_CELL_DPI, and as wide in inches
+// on denser screens
+#define GOL_CELL_SIZE 10
+#define GOL_CELL_DPI 96.0
+// most a cycle may take to replay, planes and tile flags of every generation
+#define GOL_REPLAY_MEMORY (64UL << 20)
+// reseeding a settled grid fills about one in that many tiles with a new soup
+#define GOL_RESEED_TILES 8
+
+static double gol_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
 
-#define CELL_ALIVE  (1 << 0)
-#define CELL_BORN   (1 << 1)
-#define CELL_KILL   (1 << 2)
-#define CELL_GET_AGE(x)  (((x) & 0xFFFF0000) >> 16)
-#define CELL_INC_AGE(x)  ((x) + 0x10000)
+// rand() % 2 at the default density, so a given srand() seed gives the same
+// soup as it always did
+static bool gol_seed_alive(const double density) {
+    if (density == 0.5) {
+        return (rand() % 2) == 1;
+    }
+    return rand() < density * ((double)RAND_MAX + 1);
+}
 
-static void gol_create(struct gol* gol, const int ncells_horizontal, const int ncells_vertical) {
+// calloc() on a cache line, rounded up to whole ones so nothing else shares
+// the last.
+static void* gol_calloc_aligned(const size_t n, const size_t size) {
+    const size_t bytes = (((n * size) + GOL_CACHE_LINE - 1) / GOL_CACHE_LINE) * GOL_CACHE_LINE;
+    void* p = aligned_alloc(GOL_CACHE_LINE, bytes);
+    if (p != NULL) {
+        memset(p, 0, bytes);
+    }
+    return p;
+}
+
+// Words of a plane of the given number of lines, ghosts included.
+static size_t gol_plane_words(struct gol* gol, const int lines) {
+    return (size_t)(lines + 2) * gol->stride;
+}
+
+// Offset of the first word of line 0 in a plane.
+static size_t gol_plane_origin(struct gol* gol) {
+    return gol->stride + GOL_ROW_PAD;
+}
+
+// Allocates a cleared plane, returning its first word of line 0.
+static uint64_t* gol_plane_alloc(struct gol* gol, const int lines) {
+    return (uint64_t*)gol_calloc_aligned(gol_plane_words(gol, lines), sizeof(uint64_t)) + gol_plane_origin(gol);
+}
+
+static void gol_create(struct gol* gol, const int ncells_horizontal, const int ncells_vertical,
+                       const double density) {
     gol->cell_nv = ncells_vertical;
     gol->cell_nh = ncells_horizontal;
-    int ncells = gol->cell_nh * gol->cell_nv;
-    gol->cell_array = malloc(sizeof(unsigned int) * ncells);
-    memset(gol->cell_array, 0, sizeof(unsigned int) * ncells);
-
-#if 0
-    gol->cell_array[0] = CELL_ALIVE;
-    gol->cell_array[gol->cell_nh -1] = CELL_ALIVE;
-    gol->cell_array[((gol->cell_nv -1) * gol->cell_nh)] = CELL_ALIVE;
-    gol->cell_array[(gol->cell_nv * gol->cell_nh) - 1] = CELL_ALIVE;
-    gol->cell_array[2*gol->cell_nh + 2] = CELL_ALIVE;
-    gol->cell_array[2*gol->cell_nh + 3] = CELL_ALIVE;
-    gol->cell_array[2*gol->cell_nh + 4] = CELL_ALIVE;
-#else
-    for (int i = 0; i < (gol->cell_nh * gol->cell_nv); i++) {
-        if ((rand() % 2) == 1) {
-            gol->cell_array[i] = CELL_ALIVE;
+    gol->density = density;
+    gol->word_nh = (gol->cell_nh + GOL_WORD_BITS - 1) / GOL_WORD_BITS;
+    gol->word_straight = (gol->cell_nh % GOL_WORD_BITS == 0) ? gol->word_nh : gol->word_nh - 1;
+    // the row and its east ghost word, up to the next cache line
+    gol->stride = GOL_ROW_PAD + (((gol->word_nh + GOL_ROW_PAD) / GOL_ROW_PAD) * GOL_ROW_PAD);
+    gol->age_stride = gol->word_nh * GOL_WORD_BITS;
+    gol->last_mask = ~0ULL >> ((GOL_WORD_BITS - (gol->cell_nh % GOL_WORD_BITS)) % GOL_WORD_BITS);
+    gol->cells = gol_plane_alloc(gol, gol->cell_nv);
+    gol->next = gol_plane_alloc(gol, gol->cell_nv);
+    gol->explode = gol_plane_alloc(gol, gol->cell_nv);
+    gol->line_exploded = calloc(gol->cell_nv, sizeof(bool));
+    gol->zero_row = gol_plane_alloc(gol, 1);
+    gol->age = gol_calloc_aligned((size_t)gol->age_stride * gol->cell_nv, sizeof(uint8_t));
+
+    // Everything is computed in the first two generations, the back buffer
+    // only holds the one before the current one after the first.
+    gol->tile_nv = (gol->cell_nv + GOL_TILE_LINES - 1) / GOL_TILE_LINES;
+    int ntiles = gol->word_nh * gol->tile_nv;
+    gol->tiles = malloc(ntiles);
+    gol->next_tiles = malloc(ntiles);
+    memset(gol->tiles, GOL_TILE_CHANGED | GOL_TILE_CHANGED2 | GOL_TILE_EXPLODED, ntiles);
+    memset(gol->next_tiles, GOL_TILE_CHANGED | GOL_TILE_CHANGED2, ntiles);
+    gol->tile_solved = calloc(ntiles, sizeof(unsigned long));
+    gol->tile_wake = calloc(ntiles, sizeof(unsigned long));
+
+    // seed in raster order so a given srand() seed gives the same soup as
+    // the old one-word-per-cell grid did
+    for (int line = 0; line < gol->cell_nv; line++) {
+        uint64_t* row = gol->cells + (line * gol->stride);
+        for (int col = 0; col < gol->cell_nh; col++) {
+            if (gol_seed_alive(density)) {
+                row[col / GOL_WORD_BITS] |= 1ULL << (col % GOL_WORD_BITS);
+            }
         }
     }
-#endif
+}
+
+static void gol_free(struct gol* gol) {
+    const size_t origin = gol_plane_origin(gol);
+    free(gol->cells - origin);
+    free(gol->next - origin);
+    free(gol->explode - origin);
+    free(gol->zero_row - origin);
+    free(gol->line_exploded);
+    free(gol->age);
+    free(gol->tiles);
+    free(gol->next_tiles);
+    free(gol->tile_solved);
+    free(gol->tile_wake);
+    memset(gol, 0, sizeof(*gol));
 }
 
 static int gol_cell_index(struct gol* gol, const int col, const int line) {
@@ -67,110 +319,1463 @@ static int gol_cell_index(struct gol* gol, const int col, const int line) {
 }
 
 static bool gol_cell_is_alive_(struct gol *gol, const int col, const int line) {
-    bool alive = false;
     int i = gol_cell_index(gol, col, line);
-    if ((gol->cell_array[i] & CELL_ALIVE) != 0) {
-        alive = true;
+    int col_ = i % gol->cell_nh;
+    int line_ = i / gol->cell_nh;
+    uint64_t word = gol->cells[(line_ * gol->stride) + (col_ / GOL_WORD_BITS)];
+    return ((word >> (col_ % GOL_WORD_BITS)) & 1) != 0;
+}
+
+// returns the given row of a plane, the ghost rows for lines -1 and cell_nv
+static inline uint64_t* gol_row(struct gol* gol, uint64_t* plane, int line) {
+    return plane + (line * gol->stride);
+}
+
+// word w of the row shifted by one cell, so each bit holds its (col -1)
+// neighbour, through the ghost word for w = 0
+static inline uint64_t gol_halo_west(const uint64_t* row, const int w) {
+    return (row[w] << 1) | (row[w - 1] >> (GOL_WORD_BITS - 1));
+}
+
+// word w of the row shifted by one cell, so each bit holds its (col +1)
+// neighbour, through the ghost word for the last word if whole; for words
+// below word_straight only
+static inline uint64_t gol_halo_east(const uint64_t* row, const int w) {
+    return (row[w] >> 1) | (row[w + 1] << (GOL_WORD_BITS - 1));
+}
+
+// Copies the last cell of each row into the ghost word west of it, the first
+// word of each row into the ghost word east of it, then the last and first
+// rows into the ghost rows above and below the plane.
+static void gol_halo_refresh(struct gol* gol, uint64_t* plane) {
+    const double start = gol_now();
+    const int last_bit = (gol->cell_nh - 1) % GOL_WORD_BITS;
+    for (int line = 0; line < gol->cell_nv; line++) {
+        uint64_t* row = gol_row(gol, plane, line);
+        row[-1] = row[gol->word_nh - 1] << (GOL_WORD_BITS - 1 - last_bit);
+        row[gol->word_nh] = row[0];
     }
-    return alive;
+    const size_t ghosted = (gol->word_nh + 2) * sizeof(uint64_t);
+    memcpy(gol_row(gol, plane, -1) - 1, gol_row(gol, plane, gol->cell_nv - 1) - 1, ghosted);
+    memcpy(gol_row(gol, plane, gol->cell_nv) - 1, gol_row(gol, plane, 0) - 1, ghosted);
+    gol->halo_seconds += gol_now() - start;
 }
 
+// gol_halo_west() for planes without ghosts, wrapping around the row instead
+static inline uint64_t gol_row_west(struct gol* gol, const uint64_t* row, const int w) {
+    uint64_t carry;
+    if (w > 0) {
+        carry = row[w - 1] >> (GOL_WORD_BITS - 1);
+    } else {
+        carry = (row[gol->word_nh - 1] >> ((gol->cell_nh - 1) % GOL_WORD_BITS)) & 1;
+    }
+    return (row[w] << 1) | carry;
+}
 
-static int gol_cell_age(struct gol* gol, const int col, const int line) {
-    int i = gol_cell_index(gol, col, line);
-    return CELL_GET_AGE(gol->cell_array[i]);
+// gol_halo_east() for planes without ghosts, or a partial last word
+static inline uint64_t gol_row_east(struct gol* gol, const uint64_t* row, const int w) {
+    uint64_t word = row[w] >> 1;
+    if (w < gol->word_nh - 1) {
+        word |= row[w + 1] << (GOL_WORD_BITS - 1);
+    } else {
+        word |= (row[0] & 1) << ((gol->cell_nh - 1) % GOL_WORD_BITS);
+    }
+    return word;
 }
 
-static void gol_cell_age_inc(struct gol* gol, const int col, const int line) {
-    int i = gol_cell_index(gol, col, line);
-    gol->cell_array[i] += 0x10000;
+// Parses "B3/S23", "b36s23" or "S23/B3" into a rule. Rules with B0 are
+// refused: every empty region would flash on and off with them.
+static bool gol_rule_parse(const char* rulestring, struct gol_rule* rule) {
+    uint16_t* column = NULL;
+    bool has_born = false;
+    bool has_survive = false;
+    rule->born = 0;
+    rule->survive = 0;
+    for (const char* p = rulestring; *p != '\0'; p++) {
+        if ((*p == 'B' || *p == 'b') && !has_born) {
+            column = &rule->born;
+            has_born = true;
+        } else if ((*p == 'S' || *p == 's') && !has_survive) {
+            column = &rule->survive;
+            has_survive = true;
+        } else if (*p >= '0' && *p <= '8' && column != NULL) {
+            *column |= 1 << (*p - '0');
+        } else if (*p != '/') {
+            return false;
+        }
+    }
+    return has_born && has_survive && !(rule->born & 1);
 }
 
-static void gol_cell_mark_kill(struct gol* gol, const int col, const int line) {
-    int i = gol_cell_index(gol, col, line);
-    gol->cell_array[i] |= CELL_KILL;
+// The rule in canonical notation, "B3/S23", into a buffer of at least 22 bytes.
+static void gol_rule_format(const struct gol_rule* rule, char* buf) {
+    *buf++ = 'B';
+    for (int k = 0; k <= 8; k++) {
+        if (rule->born & (1 << k)) {
+            *buf++ = '0' + k;
+        }
+    }
+    *buf++ = '/';
+    *buf++ = 'S';
+    for (int k = 0; k <= 8; k++) {
+        if (rule->survive & (1 << k)) {
+            *buf++ = '0' + k;
+        }
+    }
+    *buf = '\0';
 }
 
-static void gol_cell_mark_born(struct gol* gol, const int col, const int line) {
-    int i = gol_cell_index(gol, col, line);
-    gol->cell_array[i] |= CELL_BORN;
+// The kernels below apply a rule to 64 cells at once with bit-sliced adders,
+// written once with the and/or/xor/andnot of a vector ISA, where ANDNOT(a, b)
+// is a & ~b, and ONES has every bit set. Each rule gets its own kernels for
+// each ISA, which compile down to a few dozen boolean instructions a word;
+// other rules go through GOL_SOLVE_TABLE(), which reads the 2x9 table.
+
+// Conway's B3/S23, rules 1-4. Rows above and below are summed into 2-bit
+// counts, the middle row into a 2-bit count of its two neighbours, then the
+// three are added. A cell has 2 or 3 neighbours exactly when the twos column
+// holds a single bit, and 3 when the ones column is set too.
+#define GOL_SOLVE_CONWAY(T, AND, OR, XOR, ANDNOT, ONES, nw, n, ne, w, c, e, sw, s, se, out) \
+    do {                                                                                   \
+        T n0_ = XOR(XOR(nw, n), ne);                                                       \
+        T n1_ = OR(AND(nw, n), AND(ne, XOR(nw, n)));                                       \
+        T s0_ = XOR(XOR(sw, s), se);                                                       \
+        T s1_ = OR(AND(sw, s), AND(se, XOR(sw, s)));                                       \
+        T m0_ = XOR(w, e);                                                                 \
+        T m1_ = AND(w, e);                                                                 \
+        T ones_ = XOR(XOR(n0_, s0_), m0_);                                                 \
+        T carry_ = OR(AND(n0_, s0_), AND(m0_, XOR(n0_, s0_)));                             \
+        T pair_ = XOR(XOR(n1_, s1_), XOR(m1_, carry_));                                    \
+        pair_ = ANDNOT(ANDNOT(pair_, AND(n1_, s1_)), AND(m1_, carry_));                    \
+        out = AND(pair_, OR(ones_, c));                                                    \
+    } while (0)
+
+// The full neighbour count, 0 to 8, as the bits b0_ to b3_.
+#define GOL_COUNT(T, AND, OR, XOR, nw, n, ne, w, e, sw, s, se)        \
+    T n0_ = XOR(XOR(nw, n), ne);                                      \
+    T n1_ = OR(AND(nw, n), AND(ne, XOR(nw, n)));                      \
+    T s0_ = XOR(XOR(sw, s), se);                                      \
+    T s1_ = OR(AND(sw, s), AND(se, XOR(sw, s)));                      \
+    T m0_ = XOR(w, e);                                                \
+    T m1_ = AND(w, e);                                                \
+    T b0_ = XOR(XOR(n0_, s0_), m0_);                                  \
+    T carry_ = OR(AND(n0_, s0_), AND(m0_, XOR(n0_, s0_)));            \
+    T ns_ = XOR(n1_, s1_);                                            \
+    T mc_ = XOR(m1_, carry_);                                         \
+    T b1_ = XOR(ns_, mc_);                                            \
+    T fours_ = AND(ns_, mc_);                                         \
+    T nsc_ = AND(n1_, s1_);                                           \
+    T mcc_ = AND(m1_, carry_);                                        \
+    T b2_ = XOR(XOR(nsc_, mcc_), fours_);                             \
+    T b3_ = OR(AND(nsc_, mcc_), AND(fours_, XOR(nsc_, mcc_)))
+
+// HighLife, B36/S23: 3 and 6 only differ from 2 and 7 in b0 ^ b2.
+#define GOL_SOLVE_HIGHLIFE(T, AND, OR, XOR, ANDNOT, ONES, nw, n, ne, w, c, e, sw, s, se, out) \
+    do {                                                                                     \
+        GOL_COUNT(T, AND, OR, XOR, nw, n, ne, w, e, sw, s, se);                              \
+        T two_or_three_ = ANDNOT(ANDNOT(b1_, b2_), b3_);                                     \
+        T born_ = AND(ANDNOT(b1_, b3_), XOR(b0_, b2_));                                      \
+        out = OR(AND(two_or_three_, c), ANDNOT(born_, c));                                   \
+    } while (0)
+
+// Day & Night, B3678/S34678: born with 3, 6, 7 or 8 neighbours, and survives
+// with 4 as well.
+#define GOL_SOLVE_DAYNIGHT(T, AND, OR, XOR, ANDNOT, ONES, nw, n, ne, w, c, e, sw, s, se, out) \
+    do {                                                                                     \
+        GOL_COUNT(T, AND, OR, XOR, nw, n, ne, w, e, sw, s, se);                              \
+        T born_ = OR(b3_, AND(b1_, OR(b2_, b0_)));                                           \
+        T four_ = ANDNOT(ANDNOT(b2_, b1_), b0_);                                             \
+        out = OR(born_, AND(four_, c));                                                      \
+    } while (0)
+
+// Any rule, from the table of the gol in scope: every neighbour count the
+// rule has an entry for is matched on its own and the matches are or'ed.
+#define GOL_SOLVE_TABLE(T, AND, OR, XOR, ANDNOT, ONES, nw, n, ne, w, c, e, sw, s, se, out) \
+    do {                                                                                  \
+        GOL_COUNT(T, AND, OR, XOR, nw, n, ne, w, e, sw, s, se);                           \
+        const T bits_[4] = {b0_, b1_, b2_, b3_};                                          \
+        const T not_bits_[4] = {ANDNOT(ONES, b0_), ANDNOT(ONES, b1_),                     \
+                                ANDNOT(ONES, b2_), ANDNOT(ONES, b3_)};                    \
+        out = XOR(c, c);                                                                  \
+        for (int k_ = 0; k_ <= 8; k_++) {                                                 \
+            const bool born_ = (gol->rule.born >> k_) & 1;                                \
+            const bool survive_ = (gol->rule.survive >> k_) & 1;                          \
+            if (!born_ && !survive_) {                                                    \
+                continue;                                                                 \
+            }                                                                             \
+            T match_ = (k_ & 1) ? bits_[0] : not_bits_[0];                                \
+            match_ = AND(match_, (k_ & 2) ? bits_[1] : not_bits_[1]);                     \
+            match_ = AND(match_, (k_ & 4) ? bits_[2] : not_bits_[2]);                     \
+            match_ = AND(match_, (k_ & 8) ? bits_[3] : not_bits_[3]);                     \
+            if (!survive_) {                                                              \
+                match_ = ANDNOT(match_, c);                                               \
+            } else if (!born_) {                                                          \
+                match_ = AND(match_, c);                                                  \
+            }                                                                             \
+            out = OR(out, match_);                                                        \
+        }                                                                                 \
+    } while (0)
+
+#define GOL_U64_AND(a, b) ((a) & (b))
+#define GOL_U64_OR(a, b) ((a) | (b))
+#define GOL_U64_XOR(a, b) ((a) ^ (b))
+#define GOL_U64_ANDNOT(a, b) ((a) & ~(b))
+
+// Row kernels apply a rule to the words [first, last) of a line, given the
+// lines above and below it, shifting cells across word boundaries with a
+// second load one word to the left or right; the ghost words stand in past
+// either end of the row. Only a partial last word wraps around, through the
+// scalar kernel.
+#define GOL_KERNEL_SCALAR(name, SOLVE)                                                                    \
+    static inline uint64_t name##_word(struct gol* gol, const uint64_t nw, const uint64_t n,              \
+                                       const uint64_t ne, const uint64_t w, const uint64_t c,             \
+                                       const uint64_t e, const uint64_t sw, const uint64_t s,             \
+                                       const uint64_t se) {                                               \
+        (void)gol; /* only the table kernels look at the rule */                                          \
+        uint64_t out;                                                                                     \
+        SOLVE(uint64_t, GOL_U64_AND, GOL_U64_OR, GOL_U64_XOR, GOL_U64_ANDNOT, ~0ULL,                      \
+              nw, n, ne, w, c, e, sw, s, se, out);                                                        \
+        return out;                                                                                       \
+    }                                                                                                     \
+    static void name(struct gol* gol, const uint64_t* up, const uint64_t* mid, const uint64_t* down,      \
+                     uint64_t* next, const int first, const int last) {                                   \
+        const int end = (last < gol->word_straight) ? last : gol->word_straight;                          \
+        int w = first;                                                                                    \
+        for (; w < end; w++) {                                                                            \
+            next[w] = name##_word(gol, gol_halo_west(up, w), up[w], gol_halo_east(up, w),                 \
+                                  gol_halo_west(mid, w), mid[w], gol_halo_east(mid, w),                   \
+                                  gol_halo_west(down, w), down[w], gol_halo_east(down, w));               \
+        }                                                                                                 \
+        /* a partial last word, east of which is the first cell of the row */                             \
+        for (; w < last; w++) {                                                                           \
+            next[w] = name##_word(gol, gol_halo_west(up, w), up[w], gol_row_east(gol, up, w),             \
+                                  gol_halo_west(mid, w), mid[w], gol_row_east(gol, mid, w),               \
+                                  gol_halo_west(down, w), down[w], gol_row_east(gol, down, w));           \
+        }                                                                                                 \
+    }
+
+GOL_KERNEL_SCALAR(gol_kernel_scalar, GOL_SOLVE_CONWAY)
+GOL_KERNEL_SCALAR(gol_kernel_scalar_highlife, GOL_SOLVE_HIGHLIFE)
+GOL_KERNEL_SCALAR(gol_kernel_scalar_daynight, GOL_SOLVE_DAYNIGHT)
+GOL_KERNEL_SCALAR(gol_kernel_scalar_table, GOL_SOLVE_TABLE)
+
+// A vector row kernel of VEC words of type T, through the given load, store,
+// shift and boolean macros of its ISA.
+#define GOL_KERNEL_VECTOR(name, attr, T, VEC, LOAD, STORE, WEST, EAST, AND, OR, XOR, ANDNOT, ONES, SOLVE, scalar) \
+    attr static void name(struct gol* gol, const uint64_t* up, const uint64_t* mid, const uint64_t* down,         \
+                          uint64_t* next, const int first, const int last) {                                      \
+        const int end = (last < gol->word_straight) ? last : gol->word_straight;                                  \
+        int w = first;                                                                                            \
+        for (; w + VEC <= end; w += VEC) {                                                                        \
+            const T nw = WEST(up, w), n = LOAD(up + w), ne = EAST(up, w);                                         \
+            const T mw = WEST(mid, w), c = LOAD(mid + w), me = EAST(mid, w);                                      \
+            const T sw = WEST(down, w), s = LOAD(down + w), se = EAST(down, w);                                   \
+            T out;                                                                                                \
+            SOLVE(T, AND, OR, XOR, ANDNOT, ONES, nw, n, ne, mw, c, me, sw, s, se, out);                           \
+            STORE(next + w, out);                                                                                 \
+        }                                                                                                         \
+        scalar(gol, up, mid, down, next, w, last);                                                                \
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define GOL_AVX2_ANDNOT(a, b) _mm256_andnot_si256((b), (a))
+#define GOL_AVX2_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define GOL_AVX2_STORE(p, v) _mm256_storeu_si256((__m256i*)(p), (v))
+#define GOL_AVX2_WEST(row, w) _mm256_or_si256(_mm256_slli_epi64(GOL_AVX2_LOAD((row) + (w)), 1), \
+                                              _mm256_srli_epi64(GOL_AVX2_LOAD((row) + (w) - 1), 63))
+#define GOL_AVX2_EAST(row, w) _mm256_or_si256(_mm256_srli_epi64(GOL_AVX2_LOAD((row) + (w)), 1), \
+                                              _mm256_slli_epi64(GOL_AVX2_LOAD((row) + (w) + 1), 63))
+#define GOL_KERNEL_AVX2(name, SOLVE, scalar)                                                              \
+    GOL_KERNEL_VECTOR(name, __attribute__((target("avx2"))), __m256i, 4, GOL_AVX2_LOAD, GOL_AVX2_STORE,   \
+                      GOL_AVX2_WEST, GOL_AVX2_EAST, _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, \
+                      GOL_AVX2_ANDNOT, _mm256_set1_epi64x(-1), SOLVE, scalar)
+
+GOL_KERNEL_AVX2(gol_kernel_row_avx2, GOL_SOLVE_CONWAY, gol_kernel_scalar)
+GOL_KERNEL_AVX2(gol_kernel_row_avx2_highlife, GOL_SOLVE_HIGHLIFE, gol_kernel_scalar_highlife)
+GOL_KERNEL_AVX2(gol_kernel_row_avx2_daynight, GOL_SOLVE_DAYNIGHT, gol_kernel_scalar_daynight)
+GOL_KERNEL_AVX2(gol_kernel_row_avx2_table, GOL_SOLVE_TABLE, gol_kernel_scalar_table)
+
+#define GOL_SSE2_ANDNOT(a, b) _mm_andnot_si128((b), (a))
+#define GOL_SSE2_LOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define GOL_SSE2_STORE(p, v) _mm_storeu_si128((__m128i*)(p), (v))
+#define GOL_SSE2_WEST(row, w) _mm_or_si128(_mm_slli_epi64(GOL_SSE2_LOAD((row) + (w)), 1), \
+                                           _mm_srli_epi64(GOL_SSE2_LOAD((row) + (w) - 1), 63))
+#define GOL_SSE2_EAST(row, w) _mm_or_si128(_mm_srli_epi64(GOL_SSE2_LOAD((row) + (w)), 1), \
+                                           _mm_slli_epi64(GOL_SSE2_LOAD((row) + (w) + 1), 63))
+#define GOL_KERNEL_SSE2(name, SOLVE, scalar)                                                             \
+    GOL_KERNEL_VECTOR(name, __attribute__((target("sse2"))), __m128i, 2, GOL_SSE2_LOAD, GOL_SSE2_STORE, \
+                      GOL_SSE2_WEST, GOL_SSE2_EAST, _mm_and_si128, _mm_or_si128, _mm_xor_si128,        \
+                      GOL_SSE2_ANDNOT, _mm_set1_epi64x(-1), SOLVE, scalar)
+
+GOL_KERNEL_SSE2(gol_kernel_row_sse2, GOL_SOLVE_CONWAY, gol_kernel_scalar)
+GOL_KERNEL_SSE2(gol_kernel_row_sse2_highlife, GOL_SOLVE_HIGHLIFE, gol_kernel_scalar_highlife)
+GOL_KERNEL_SSE2(gol_kernel_row_sse2_daynight, GOL_SOLVE_DAYNIGHT, gol_kernel_scalar_daynight)
+GOL_KERNEL_SSE2(gol_kernel_row_sse2_table, GOL_SOLVE_TABLE, gol_kernel_scalar_table)
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+
+#define GOL_NEON_ANDNOT(a, b) vbicq_u64((a), (b))
+#define GOL_NEON_WEST(row, w) vorrq_u64(vshlq_n_u64(vld1q_u64((row) + (w)), 1), \
+                                        vshrq_n_u64(vld1q_u64((row) + (w) - 1), 63))
+#define GOL_NEON_EAST(row, w) vorrq_u64(vshrq_n_u64(vld1q_u64((row) + (w)), 1), \
+                                        vshlq_n_u64(vld1q_u64((row) + (w) + 1), 63))
+#define GOL_KERNEL_NEON(name, SOLVE, scalar)                                                           \
+    GOL_KERNEL_VECTOR(name, , uint64x2_t, 2, vld1q_u64, vst1q_u64, GOL_NEON_WEST, GOL_NEON_EAST,      \
+                      vandq_u64, vorrq_u64, veorq_u64, GOL_NEON_ANDNOT, vdupq_n_u64(~0ULL), SOLVE, scalar)
+
+GOL_KERNEL_NEON(gol_kernel_row_neon, GOL_SOLVE_CONWAY, gol_kernel_scalar)
+GOL_KERNEL_NEON(gol_kernel_row_neon_highlife, GOL_SOLVE_HIGHLIFE, gol_kernel_scalar_highlife)
+GOL_KERNEL_NEON(gol_kernel_row_neon_daynight, GOL_SOLVE_DAYNIGHT, gol_kernel_scalar_daynight)
+GOL_KERNEL_NEON(gol_kernel_row_neon_table, GOL_SOLVE_TABLE, gol_kernel_scalar_table)
+#endif
+
+// The block lookup kernel: every 4x4 block of cells, read as a 16 bit index
+// (line y in bits 4y to 4y + 3, the westmost cell in the lowest), looks up
+// the next generation of its 2x2 centre in a table of 64K entries (the upper
+// line in bits 0 and 1). Blocks overlap by two cells each way, so one lookup
+// gives two cells of two lines. It needs no SIMD, but is slower than the
+// bit-sliced kernels and only picked when asked for with gol_set_kernel().
+static uint8_t gol_lut[1 << 16];
+static struct gol_rule gol_lut_rule;
+static bool gol_lut_built = false;
+
+// fills the table for the rule, once unless the rule changes
+static void gol_lut_build(const struct gol_rule* rule) {
+    if (gol_lut_built && gol_lut_rule.born == rule->born && gol_lut_rule.survive == rule->survive) {
+        return;
+    }
+    for (int index = 0; index < (1 << 16); index++) {
+        uint8_t centre = 0;
+        for (int y = 1; y <= 2; y++) {
+            for (int x = 1; x <= 2; x++) {
+                int neighbours = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        if (dy != 0 || dx != 0) {
+                            neighbours += (index >> (((y + dy) * 4) + x + dx)) & 1;
+                        }
+                    }
+                }
+                const bool alive = (index >> ((y * 4) + x)) & 1;
+                const uint16_t column = alive ? rule->survive : rule->born;
+                centre |= ((column >> neighbours) & 1) << (((y - 1) * 2) + (x - 1));
+            }
+        }
+        gol_lut[index] = centre;
+    }
+    gol_lut_rule = *rule;
+    gol_lut_built = true;
 }
 
-static void gol_solve(struct gol* gol) {
-    for (int line = 0; line < gol->cell_nv; line++) {
-        for (int col = 0; col < gol->cell_nh; col++) {
-            int n_alive = 0;
-
-            if (gol_cell_is_alive_(gol, col -1, line -1)) { n_alive++; }
-            if (gol_cell_is_alive_(gol, col   , line -1)) { n_alive++; }
-            if (gol_cell_is_alive_(gol, col +1, line -1)) { n_alive++; }
-            if (gol_cell_is_alive_(gol, col -1, line   )) { n_alive++; }
-            if (gol_cell_is_alive_(gol, col +1, line   )) { n_alive++; }
-            if (gol_cell_is_alive_(gol, col -1, line +1)) { n_alive++; }
-            if (gol_cell_is_alive_(gol, col   , line +1)) { n_alive++; }
-            if (gol_cell_is_alive_(gol, col +1, line +1)) { n_alive++; }
-            
-
-            // game of life rules https://en.wikipedia.org/wiki/Conway's_Game_of_Life#Rules
-            // 1. Any live cell with fewer than two live neighbours dies, as if by underpopulation.
-            // 2. Any live cell with two or three live neighbours lives on to the next generation.
-            // 3. Any live cell with more than three live neighbours dies, as if by overpopulation.
-            // 4. Any dead cell with exactly three live neighbours becomes a live cell, as if by reproduction.
-            // 5. Any live cell with that is alive for more than 100 cycles explodes and dies, giving its live to all other its neighbours.
-            if (gol_cell_is_alive_(gol, col, line)) {
-                gol_cell_age_inc(gol, col, line);
-                if (n_alive < 2 || n_alive > 3) {
-                    gol_cell_mark_kill(gol, col, line);
+// The lines mid and down of the words [first, last), given the lines around
+// them; next_below may be NULL for the line mid alone. Each block is made of
+// two cells of the rows shifted east by one cell, which hold the cells 2j - 1
+// and 2j, then two of the rows shifted west, 2j + 1 and 2j + 2, wrapping
+// around where need be.
+static void gol_kernel_lut_lines(struct gol* gol, const uint64_t* up, const uint64_t* mid, const uint64_t* down,
+                                 const uint64_t* below, uint64_t* next, uint64_t* next_below, const int first,
+                                 const int last) {
+    for (int w = first; w < last; w++) {
+        uint64_t west[4] = {gol_halo_west(up, w), gol_halo_west(mid, w), gol_halo_west(down, w),
+                            gol_halo_west(below, w)};
+        uint64_t east[4];
+        if (w < gol->word_straight) {
+            east[0] = gol_halo_east(up, w);
+            east[1] = gol_halo_east(mid, w);
+            east[2] = gol_halo_east(down, w);
+            east[3] = gol_halo_east(below, w);
+        } else {
+            east[0] = gol_row_east(gol, up, w);
+            east[1] = gol_row_east(gol, mid, w);
+            east[2] = gol_row_east(gol, down, w);
+            east[3] = gol_row_east(gol, below, w);
+        }
+        uint64_t upper = 0;
+        uint64_t lower = 0;
+        for (int j = 0; j < 64; j += 2) {
+            const unsigned int index = (west[0] & 0x3) | ((east[0] & 0x3) << 2) |
+                                       ((west[1] & 0x3) << 4) | ((east[1] & 0x3) << 6) |
+                                       ((west[2] & 0x3) << 8) | ((east[2] & 0x3) << 10) |
+                                       ((west[3] & 0x3) << 12) | ((east[3] & 0x3) << 14);
+            const uint64_t centre = gol_lut[index];
+            upper |= (centre & 0x3) << j;
+            lower |= (centre >> 2) << j;
+            for (int r = 0; r < 4; r++) {
+                west[r] >>= 2;
+                east[r] >>= 2;
+            }
+        }
+        next[w] = upper;
+        if (next_below != NULL) {
+            next_below[w] = lower;
+        }
+    }
+}
+
+static void gol_kernel_lut(struct gol* gol, const uint64_t* up, const uint64_t* mid, const uint64_t* down,
+                           uint64_t* next, const int first, const int last) {
+    gol_kernel_lut_lines(gol, up, mid, down, gol->zero_row, next, NULL, first, last);
+}
+
+// Widest ISA first, and for each the rules with kernels of their own before
+// the one for any rule. The block lookup kernel comes last, the others all
+// beat it.
+static const struct gol_kernel gol_kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    {"avx2", "avx2", GOL_RULE_CONWAY, gol_kernel_row_avx2, NULL},
+    {"avx2-highlife", "avx2", "B36/S23", gol_kernel_row_avx2_highlife, NULL},
+    {"avx2-daynight", "avx2", "B3678/S34678", gol_kernel_row_avx2_daynight, NULL},
+    {"avx2-table", "avx2", NULL, gol_kernel_row_avx2_table, NULL},
+    {"sse2", "sse2", GOL_RULE_CONWAY, gol_kernel_row_sse2, NULL},
+    {"sse2-highlife", "sse2", "B36/S23", gol_kernel_row_sse2_highlife, NULL},
+    {"sse2-daynight", "sse2", "B3678/S34678", gol_kernel_row_sse2_daynight, NULL},
+    {"sse2-table", "sse2", NULL, gol_kernel_row_sse2_table, NULL},
+#endif
+#if defined(__ARM_NEON)
+    {"neon", "neon", GOL_RULE_CONWAY, gol_kernel_row_neon, NULL},
+    {"neon-highlife", "neon", "B36/S23", gol_kernel_row_neon_highlife, NULL},
+    {"neon-daynight", "neon", "B3678/S34678", gol_kernel_row_neon_daynight, NULL},
+    {"neon-table", "neon", NULL, gol_kernel_row_neon_table, NULL},
+#endif
+    {"scalar", "scalar", GOL_RULE_CONWAY, gol_kernel_scalar, NULL},
+    {"scalar-highlife", "scalar", "B36/S23", gol_kernel_scalar_highlife, NULL},
+    {"scalar-daynight", "scalar", "B3678/S34678", gol_kernel_scalar_daynight, NULL},
+    {"scalar-table", "scalar", NULL, gol_kernel_scalar_table, NULL},
+    {"lut", "lut", NULL, gol_kernel_lut, gol_kernel_lut_lines},
+};
+
+static bool gol_kernel_supported(const struct gol_kernel* kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (strcmp(kernel->isa, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (strcmp(kernel->isa, "sse2") == 0) {
+        return __builtin_cpu_supports("sse2");
+    }
+#endif
+    return true;
+}
+
+static bool gol_kernel_applies(const struct gol_kernel* kernel, const struct gol_rule* rule) {
+    struct gol_rule own;
+    if (kernel->rule == NULL) {
+        return true;
+    }
+    gol_rule_parse(kernel->rule, &own);
+    return own.born == rule->born && own.survive == rule->survive;
+}
+
+static const struct gol_kernel* gol_kernel_find(const char* name) {
+    const int nkernels = sizeof(gol_kernels) / sizeof(gol_kernels[0]);
+    for (int i = 0; i < nkernels; i++) {
+        if (strcmp(gol_kernels[i].name, name) == 0) {
+            return &gol_kernels[i];
+        }
+    }
+    return NULL;
+}
+
+// picks the kernel asked for if it plays the rule, otherwise the widest
+// kernel the CPU we are running on supports, specialized for the rule if
+// there is one
+static const struct gol_kernel* gol_kernel_select(const struct gol_rule* rule, const char* wanted) {
+    const struct gol_kernel* kernel = (wanted != NULL) ? gol_kernel_find(wanted) : NULL;
+    if (kernel != NULL && gol_kernel_supported(kernel) && gol_kernel_applies(kernel, rule)) {
+        return kernel;
+    }
+    const int nkernels = sizeof(gol_kernels) / sizeof(gol_kernels[0]);
+    for (int i = 0; i < nkernels; i++) {
+        if (gol_kernel_supported(&gol_kernels[i]) && gol_kernel_applies(&gol_kernels[i], rule)) {
+            return &gol_kernels[i];
+        }
+    }
+    return &gol_kernels[nkernels - 1];
+}
+
+// game of life rules https://en.wikipedia.org/wiki/Conway's_Game_of_Life#Rules
+// (1-4 are those of the default rule, B3/S23, gol_set_rule() replaces them)
+// 1. Any live cell with fewer than two live neighbours dies, as if by underpopulation.
+// 2. Any live cell with two or three live neighbours lives on to the next generation.
+// 3. Any live cell with more than three live neighbours dies, as if by overpopulation.
+// 4. Any dead cell with exactly three live neighbours becomes a live cell, as if by reproduction.
+// 5. Any live cell with that is alive for more than 100 cycles explodes and dies, giving its live to all other its neighbours.
+//
+// Exploded cells give life to all their dead neighbours on the line, cells
+// that died this generation stay dead. Lines without explosions around them
+// are skipped, the explode plane of those is never written.
+static void gol_explode_line(struct gol* gol, const int line) {
+    const int nw = gol->word_nh;
+    const bool* exploded = gol->line_exploded;
+    const int line_up = (line == 0) ? gol->cell_nv - 1 : line - 1;
+    const int line_down = (line == gol->cell_nv - 1) ? 0 : line + 1;
+    if (!exploded[line_up] && !exploded[line] && !exploded[line_down]) {
+        return;
+    }
+
+    const uint64_t* up = exploded[line_up] ? gol_row(gol, gol->explode, line_up) : gol->zero_row;
+    const uint64_t* mid = exploded[line] ? gol_row(gol, gol->explode, line) : gol->zero_row;
+    const uint64_t* down = exploded[line_down] ? gol_row(gol, gol->explode, line_down) : gol->zero_row;
+    const uint64_t* cells = gol_row(gol, gol->cells, line);
+    uint64_t* next = gol_row(gol, gol->next, line);
+    uint8_t* age = gol->age + (line * gol->age_stride);
+    uint8_t* tiles = gol->next_tiles + ((line / GOL_TILE_LINES) * nw);
+
+    for (int w = 0; w < nw; w++) {
+        uint64_t given = gol_row_west(gol, up, w) | up[w] | gol_row_east(gol, up, w) |
+                         gol_row_west(gol, mid, w) | gol_row_east(gol, mid, w) |
+                         gol_row_west(gol, down, w) | down[w] | gol_row_east(gol, down, w);
+        uint64_t born = given & ~cells[w] & ~next[w];
+        if (w == nw - 1) {
+            born &= gol->last_mask;
+        }
+        next[w] |= born;
+        if (born != 0) {
+            tiles[w] |= GOL_TILE_CHANGED | GOL_TILE_CHANGED2 | GOL_TILE_EXPLODED;
+        }
+        while (born != 0) {
+            int bit = __builtin_ctzll(born);
+            born &= born - 1;
+            age[(w * GOL_WORD_BITS) + bit] = 0;
+        }
+    }
+}
+
+// Tiles whose neighbourhood is the same as two generations ago (still lifes,
+// period 2 oscillators, empty space) come out the same as two generations
+// ago, which is what the back buffer already holds, so they are skipped.
+// Their survivors still age though: the age is caught up once the tile is
+// computed again, which it is in time for its oldest survivor to explode.
+// Explosions break the pattern for one more generation.
+// generation at which the oldest survivor of a tile that just settled explodes
+static unsigned long gol_tile_deadline(struct gol* gol, const int tile_line, const int t) {
+    const int first = tile_line * GOL_TILE_LINES;
+    const int last = (first + GOL_TILE_LINES < gol->cell_nv) ? first + GOL_TILE_LINES : gol->cell_nv;
+    uint8_t max_age = 0;
+    for (int line = first; line < last; line++) {
+        const uint8_t* age = gol->age + (line * gol->age_stride) + (t * GOL_WORD_BITS);
+        uint64_t survivors = gol_row(gol, gol->cells, line)[t] & gol_row(gol, gol->next, line)[t];
+        while (survivors != 0) {
+            int bit = __builtin_ctzll(survivors);
+            survivors &= survivors - 1;
+            if (age[bit] > max_age) {
+                max_age = age[bit];
+            }
+        }
+    }
+    return gol->generation + GOL_EXPLODE_AGE - max_age;
+}
+
+static void gol_tiles_wake(struct gol* gol, struct gol_band* band, const int tile_line) {
+    const int nt = gol->word_nh;
+    const uint8_t* up = gol->tiles + (((tile_line + gol->tile_nv - 1) % gol->tile_nv) * nt);
+    const uint8_t* mid = gol->tiles + (tile_line * nt);
+    const uint8_t* down = gol->tiles + (((tile_line + 1) % gol->tile_nv) * nt);
+    const unsigned long* solved = gol->tile_solved + (tile_line * nt);
+    unsigned long* wake = gol->tile_wake + (tile_line * nt);
+    uint8_t* next = gol->next_tiles + (tile_line * nt);
+
+    for (int t = 0; t < nt; t++) {
+        const int west = (t == 0) ? nt - 1 : t - 1;
+        const int east = (t == nt - 1) ? 0 : t + 1;
+        const uint8_t around = up[west] | up[t] | up[east] | mid[west] | mid[t] | mid[east] |
+                               down[west] | down[t] | down[east];
+        band->active[t] = (around & GOL_TILE_CHANGED2) != 0;
+        if (!band->active[t] && gol->aging) {
+            if (solved[t] == gol->generation) {
+                wake[t] = gol_tile_deadline(gol, tile_line, t);
+            }
+            band->active[t] = gol->generation >= wake[t];
+        }
+        if (!band->active[t]) {
+            // a sleeping oscillator changes just like it did last generation
+            next[t] = mid[t] & GOL_TILE_CHANGED;
+        } else {
+            next[t] = (mid[t] & GOL_TILE_EXPLODED) ? GOL_TILE_CHANGED2 : 0;
+        }
+    }
+}
+
+static void gol_tiles_sleep(struct gol* gol, struct gol_band* band, const int tile_line) {
+    unsigned long* solved = gol->tile_solved + (tile_line * gol->word_nh);
+    for (int t = 0; t < gol->word_nh; t++) {
+        if (band->active[t]) {
+            solved[t] = gol->generation + 1;
+        }
+    }
+}
+
+// Computes rules 1-5 for the lines of a band, reading the current plane and
+// writing the next one. Explosions trail one line behind, as soon as the line
+// below has been solved; only the first and last line are left for
+// gol_band_run(), since their explosions depend on lines of other bands.
+static void gol_solve_lines(struct gol* gol, struct gol_band* band) {
+    const int nw = gol->word_nh;
+    const int first = band->first;
+    const int last = band->last;
+    // band->row_below holds the line, computed along with the one above
+    bool computed = false;
+
+    for (int line = first; line < last; line++) {
+        const int tile_line = line / GOL_TILE_LINES;
+        if (line % GOL_TILE_LINES == 0) {
+            gol_tiles_wake(gol, band, tile_line);
+        }
+        const uint64_t* up = gol_row(gol, gol->cells, line - 1);
+        const uint64_t* mid = gol_row(gol, gol->cells, line);
+        const uint64_t* down = gol_row(gol, gol->cells, line + 1);
+        uint64_t* next = gol_row(gol, gol->next, line);
+        uint64_t* explode = gol_row(gol, gol->explode, line);
+        uint8_t* age = gol->age + (line * gol->age_stride);
+        uint8_t* tiles = gol->next_tiles + (tile_line * nw);
+        const unsigned long* solved = gol->tile_solved + (tile_line * nw);
+        bool exploded = false;
+
+        if (computed) {
+            uint64_t* row = band->row;
+            band->row = band->row_below;
+            band->row_below = row;
+            computed = false;
+        } else {
+            // two lines at once if the kernel can, within a row of tiles
+            // so that the same tiles are active
+            const bool pair = (gol->kernel->lines != NULL) && (line + 1 < last) &&
+                              ((line + 1) % GOL_TILE_LINES != 0);
+            const uint64_t* below = pair ? gol_row(gol, gol->cells, line + 2) : NULL;
+            for (int w = 0; w < nw;) {
+                if (!band->active[w]) {
+                    w++;
+                    continue;
+                }
+                int end = w + 1;
+                while (end < nw && band->active[end]) {
+                    end++;
+                }
+                if (pair) {
+                    gol->kernel->lines(gol, up, mid, down, below, band->row, band->row_below, w, end);
                 } else {
-                    int age = gol_cell_age(gol, col, line);
-                    if (age > 100) {
-                        gol_cell_mark_kill(gol, col, line);
-
-                        gol_cell_mark_born(gol, col -1, line -1);
-                        gol_cell_mark_born(gol, col, line -1);
-                        gol_cell_mark_born(gol, col +1, line -1);
-                        gol_cell_mark_born(gol, col -1, line);
-                        gol_cell_mark_born(gol, col +1, line);
-                        gol_cell_mark_born(gol, col -1, line +1);
-                        gol_cell_mark_born(gol, col, line +1);
-                        gol_cell_mark_born(gol, col +1, line +1);
-                    }
+                    gol->kernel->row(gol, up, mid, down, band->row, w, end);
+                }
+                w = end;
+            }
+            computed = pair;
+        }
+
+        for (int w = 0; w < nw; w++) {
+            if (!band->active[w]) {
+                if (exploded) {
+                    explode[w] = 0;
+                }
+                continue;
+            }
+            uint64_t alive = mid[w];
+            uint64_t before = next[w];  // two generations ago
+            uint64_t word = band->row[w];
+            if (w == nw - 1) {
+                word &= gol->last_mask;
+            }
+
+            // the cells alive throughout the tile's sleep survived every generation of it
+            const unsigned long slept = gol->generation - solved[w];
+            if (slept != 0 && gol->aging) {
+                uint64_t survivors = alive & before;
+                while (survivors != 0) {
+                    int bit = __builtin_ctzll(survivors);
+                    survivors &= survivors - 1;
+                    uint8_t* cell_age = &age[(w * GOL_WORD_BITS) + bit];
+                    *cell_age = (slept < (unsigned long)(GOL_EXPLODE_AGE - *cell_age)) ? *cell_age + slept
+                                                                                        : GOL_EXPLODE_AGE;
+                }
+            }
+
+            // Only cells that would otherwise survive age into an explosion.
+            uint64_t exploding = 0;
+            uint64_t survivors = gol->aging ? (alive & word) : 0;
+            while (survivors != 0) {
+                int bit = __builtin_ctzll(survivors);
+                survivors &= survivors - 1;
+                uint8_t* cell_age = &age[(w * GOL_WORD_BITS) + bit];
+                if (*cell_age >= GOL_EXPLODE_AGE) {
+                    exploding |= 1ULL << bit;
+                } else {
+                    (*cell_age)++;
+                }
+            }
+            word &= ~exploding;
+
+            uint64_t born = gol->aging ? (word & ~alive) : 0;
+            while (born != 0) {
+                int bit = __builtin_ctzll(born);
+                born &= born - 1;
+                age[(w * GOL_WORD_BITS) + bit] = 0;
+            }
+
+            tiles[w] |= ((word != alive) ? GOL_TILE_CHANGED : 0) | ((word != before) ? GOL_TILE_CHANGED2 : 0) |
+                        ((exploding != 0) ? GOL_TILE_EXPLODED : 0);
+            next[w] = word;
+            if (exploding != 0 && !exploded) {
+                memset(explode, 0, sizeof(uint64_t) * w);
+                exploded = true;
+            }
+            if (exploded) {
+                explode[w] = exploding;
+            }
+        }
+        gol->line_exploded[line] = exploded;
+
+        if (line % GOL_TILE_LINES == GOL_TILE_LINES - 1 || line == last - 1) {
+            gol_tiles_sleep(gol, band, tile_line);
+        }
+        if (line - 1 > first) {
+            gol_explode_line(gol, line - 1);
+        }
+    }
+}
+
+// The hash of a generation is the sum of a hash of every word of the grid,
+// with its position, so it follows from the hash of the previous generation
+// and the words that changed.
+static inline uint64_t gol_word_hash(const long index, const uint64_t word) {
+    uint64_t h = word ^ ((uint64_t)index * 0x9E3779B97F4A7C15ULL);
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+static uint64_t gol_hash_plane(struct gol* gol, uint64_t* plane) {
+    uint64_t hash = 0;
+    for (int line = 0; line < gol->cell_nv; line++) {
+        const uint64_t* row = gol_row(gol, plane, line);
+        for (int w = 0; w < gol->word_nh; w++) {
+            hash += gol_word_hash(((long)line * gol->word_nh) + w, row[w]);
+        }
+    }
+    return hash;
+}
+
+// Change of the hash from the current plane to the next one over the lines
+// [first, last), which start on a row of tiles. Only the tiles whose next
+// flags say they changed are looked at, or all of them without flags.
+static uint64_t gol_hash_delta(struct gol* gol, const uint8_t* tiles, const int first, const int last) {
+    const int nw = gol->word_nh;
+    uint64_t delta = 0;
+    for (int tile_first = first; tile_first < last; tile_first += GOL_TILE_LINES) {
+        const int tile_last = (tile_first + GOL_TILE_LINES < last) ? tile_first + GOL_TILE_LINES : last;
+        const uint8_t* flags = (tiles != NULL) ? tiles + ((tile_first / GOL_TILE_LINES) * nw) : NULL;
+        for (int t = 0; t < nw; t++) {
+            if (flags != NULL && !(flags[t] & GOL_TILE_CHANGED)) {
+                continue;
+            }
+            for (int line = tile_first; line < tile_last; line++) {
+                const long index = ((long)line * nw) + t;
+                const uint64_t before = gol_row(gol, gol->cells, line)[t];
+                const uint64_t after = gol_row(gol, gol->next, line)[t];
+                if (before != after) {
+                    delta += gol_word_hash(index, after) - gol_word_hash(index, before);
                 }
-            } else {
-                if (n_alive == 3) {
-                    gol_cell_mark_born(gol, col, line);
+            }
+        }
+    }
+    return delta;
+}
+
+// Every thread of the pool owns a horizontal band of lines. The lines at the
+// edges of a band can only take explosions from the neighbouring bands after
+// a barrier, and a final barrier makes sure the whole next plane is written
+// before gol_solve() swaps it in.
+static void gol_band_run(struct gol_pool* pool, struct gol_band* band) {
+    struct gol* gol = pool->gol;
+    const bool sync = (pool->nthreads > 1);
+
+    gol_solve_lines(gol, band);
+    if (sync) {
+        pthread_barrier_wait(&pool->sync->barrier);
+    }
+
+    gol_explode_line(gol, band->first);
+    if (band->last - 1 != band->first) {
+        gol_explode_line(gol, band->last - 1);
+    }
+    // the band's lines are final, no other band writes them
+    if (gol->hashing) {
+        const double start = gol_now();
+        band->hash = gol_hash_delta(gol, gol->next_tiles, band->first, band->last);
+        band->hash_seconds = gol_now() - start;
+    }
+    if (sync) {
+        pthread_barrier_wait(&pool->sync->barrier);
+    }
+}
+
+static void* gol_worker(void* arg) {
+    struct gol_band* band = arg;
+    struct gol_pool* pool = band->pool;
+    unsigned long seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->sync->lock);
+        while (pool->round == seen) {
+            pthread_cond_wait(&pool->sync->wake, &pool->sync->lock);
+        }
+        seen = pool->round;
+        const bool stopping = pool->stopping;
+        pthread_mutex_unlock(&pool->sync->lock);
+
+        if (stopping) {
+            break;
+        }
+        gol_band_run(pool, band);
+    }
+    return NULL;
+}
+
+// Bands are made of whole rows of tiles, so each tile is only ever written by
+// one thread.
+static void gol_pool_bands(struct gol_pool* pool, const int nthreads) {
+    const struct gol* gol = pool->gol;
+    pool->nthreads = nthreads;
+    for (int i = 0; i < nthreads; i++) {
+        pool->bands[i].pool = pool;
+        pool->bands[i].first = ((gol->tile_nv * i) / nthreads) * GOL_TILE_LINES;
+        pool->bands[i].last = ((gol->tile_nv * (i + 1)) / nthreads) * GOL_TILE_LINES;
+        if (pool->bands[i].last > gol->cell_nv) {
+            pool->bands[i].last = gol->cell_nv;
+        }
+    }
+}
+
+// Threads are only spawned on the first update: i3lock forks after mapping
+// its window and the worker threads would not survive that.
+static void gol_pool_start(struct gol_pool* pool) {
+    pool->running = true;
+    if (pool->nthreads == 1) {
+        return;
+    }
+
+    pool->sync = malloc(sizeof(struct gol_pool_sync));
+    if (pool->sync == NULL) {
+        gol_pool_bands(pool, 1);
+        return;
+    }
+    pthread_mutex_init(&pool->sync->lock, NULL);
+    pthread_cond_init(&pool->sync->wake, NULL);
+    pool->round = 0;
+
+    int started = 1;
+    while (started < pool->nthreads) {
+        if (pthread_create(&pool->threads[started], NULL, gol_worker, &pool->bands[started]) != 0) {
+            fprintf(stderr, "[i3lock] gol: could only start %d of %d worker threads\n", started, pool->nthreads);
+            break;
+        }
+        started++;
+    }
+    if (started < pool->nthreads) {
+        // the threads that did start only pick up bands once round moves on
+        gol_pool_bands(pool, started);
+    }
+    pthread_barrier_init(&pool->sync->barrier, NULL, pool->nthreads);
+}
+
+// Joins the threads started by gol_pool_start() and frees the pool. After a
+// fork they are gone and their sync is left alone, see struct gol_pool_sync.
+static void gol_pool_free(struct gol_pool* pool) {
+    if (pool->running && pool->nthreads > 1) {
+        pthread_mutex_lock(&pool->sync->lock);
+        pool->stopping = true;
+        pool->round++;
+        pthread_cond_broadcast(&pool->sync->wake);
+        pthread_mutex_unlock(&pool->sync->lock);
+        for (int i = 1; i < pool->nthreads; i++) {
+            pthread_join(pool->threads[i], NULL);
+        }
+        pthread_barrier_destroy(&pool->sync->barrier);
+        pthread_cond_destroy(&pool->sync->wake);
+        pthread_mutex_destroy(&pool->sync->lock);
+        free(pool->sync);
+    }
+    if (pool->bands != NULL) {
+        for (int i = 0; i < pool->nthreads_wanted; i++) {
+            free(pool->bands[i].row);
+            free(pool->bands[i].row_below);
+            free(pool->bands[i].active);
+        }
+    }
+    free(pool->bands);
+    free(pool->threads);
+    memset(pool, 0, sizeof(*pool));
+}
+
+static void gol_pool_atfork_child(void) {
+    for (int i = 0; i < _ngames; i++) {
+        struct gol_pool* pool = &_games[i].pool;
+        pool->running = false;
+        if (pool->bands != NULL) {
+            gol_pool_bands(pool, pool->nthreads_wanted);
+        }
+    }
+}
+
+static void gol_pool_init(struct gol_pool* pool, struct gol* gol, int nthreads) {
+    if (nthreads <= 0) {
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    // waking up a thread costs more than solving a few thousand words
+    long nwords = (long)gol->word_nh * gol->cell_nv;
+    if (nthreads > nwords / GOL_BAND_MIN_WORDS) {
+        nthreads = nwords / GOL_BAND_MIN_WORDS;
+    }
+    if (nthreads > gol->tile_nv) {
+        nthreads = gol->tile_nv;
+    }
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+
+    pool->gol = gol;
+    pool->running = false;
+    pool->nthreads_wanted = nthreads;
+    pool->threads = calloc(nthreads, sizeof(pthread_t));
+    pool->bands = gol_calloc_aligned(nthreads, sizeof(struct gol_band));
+    for (int i = 0; i < nthreads; i++) {
+        pool->bands[i].row = gol_calloc_aligned(gol->word_nh, sizeof(uint64_t));
+        pool->bands[i].row_below = gol_calloc_aligned(gol->word_nh, sizeof(uint64_t));
+        pool->bands[i].active = gol_calloc_aligned(gol->word_nh, sizeof(bool));
+    }
+    gol_pool_bands(pool, nthreads);
+    static bool atfork = false;
+    if (!atfork) {
+        pthread_atfork(NULL, NULL, gol_pool_atfork_child);
+        atfork = true;
+    }
+}
+
+static void gol_solve(struct gol_pool* pool) {
+    if (!pool->running) {
+        gol_pool_start(pool);
+    }
+    // the cells changed since the last time, by the kernels, explosions or reseeding
+    gol_halo_refresh(pool->gol, pool->gol->cells);
+    if (pool->nthreads > 1) {
+        pthread_mutex_lock(&pool->sync->lock);
+        pool->round++;
+        pthread_cond_broadcast(&pool->sync->wake);
+        pthread_mutex_unlock(&pool->sync->lock);
+    }
+    gol_band_run(pool, &pool->bands[0]);
+
+    // publish the new generation
+    struct gol* gol = pool->gol;
+    if (gol->hashing) {
+        // the bands hash in parallel, the slowest one is what it cost
+        double seconds = 0;
+        for (int i = 0; i < pool->nthreads; i++) {
+            gol->hash += pool->bands[i].hash;
+            if (pool->bands[i].hash_seconds > seconds) {
+                seconds = pool->bands[i].hash_seconds;
+            }
+        }
+        gol->hash_seconds += seconds;
+    }
+    uint64_t* cells = gol->cells;
+    gol->cells = gol->next;
+    gol->next = cells;
+    uint8_t* tiles = gol->tiles;
+    gol->tiles = gol->next_tiles;
+    gol->next_tiles = tiles;
+    gol->generation++;
+}
+
+// Same as gol_solve() but through HashLife, 2^step_log2 generations at once.
+static void gol_solve_hashlife(struct gol* gol, struct gol_hashlife* universe, const int step_log2) {
+    gol_hashlife_step(universe);
+    gol_hashlife_store(universe, gol->next, gol->stride);
+    if (gol->hashing) {
+        const double start = gol_now();
+        gol->hash += gol_hash_delta(gol, NULL, 0, gol->cell_nv);
+        gol->hash_seconds += gol_now() - start;
+    }
+
+    uint64_t* cells = gol->cells;
+    gol->cells = gol->next;
+    gol->next = cells;
+    gol->generation += 1UL << step_log2;
+}
+
+// The back buffer still holds the previous generation until the next
+// gol_solve(), so the cells that changed are the ones differing between the
+// two planes.
+static int gol_next_changed_(struct gol* gol, const int col, const int line) {
+    if (col < 0 || col >= gol->cell_nh || line < 0 || line >= gol->cell_nv) {
+        return -1;
+    }
+    const uint64_t* cells = gol_row(gol, gol->cells, line);
+    const uint64_t* prev = gol_row(gol, gol->next, line);
+    const uint8_t* tiles = gol->tiles + ((line / GOL_TILE_LINES) * gol->word_nh);
+    int w = col / GOL_WORD_BITS;
+    uint64_t diff = 0;
+    if (tiles[w] & GOL_TILE_CHANGED) {
+        diff = (cells[w] ^ prev[w]) & (~0ULL << (col % GOL_WORD_BITS));
+    }
+    while (diff == 0) {
+        if (++w == gol->word_nh) {
+            return -1;
+        }
+        if (tiles[w] & GOL_TILE_CHANGED) {
+            diff = cells[w] ^ prev[w];
+        }
+    }
+    return (w * GOL_WORD_BITS) + __builtin_ctzll(diff);
+}
+
+// Fills about one in GOL_RESEED_TILES tiles, picked at random, with a new soup.
+// The tiles are flagged like the whole grid is on creation, so they and their
+// neighbours are computed again.
+static void gol_reseed(struct gol* gol) {
+    const int nw = gol->word_nh;
+    const int ntiles = nw * gol->tile_nv;
+    const int count = (ntiles > GOL_RESEED_TILES) ? ntiles / GOL_RESEED_TILES : 1;
+    for (int i = 0; i < count; i++) {
+        const int tile = rand() % ntiles;
+        const int t = tile % nw;
+        const int first = (tile / nw) * GOL_TILE_LINES;
+        const int last = (first + GOL_TILE_LINES < gol->cell_nv) ? first + GOL_TILE_LINES : gol->cell_nv;
+        for (int line = first; line < last; line++) {
+            uint64_t word = 0;
+            for (int bit = 0; bit < GOL_WORD_BITS && (t * GOL_WORD_BITS) + bit < gol->cell_nh; bit++) {
+                if (gol_seed_alive(gol->density)) {
+                    word |= 1ULL << bit;
                 }
+                gol->age[(line * gol->age_stride) + (t * GOL_WORD_BITS) + bit] = 0;
             }
+            gol_row(gol, gol->cells, line)[t] = word;
         }
+        gol->tiles[tile] |= GOL_TILE_CHANGED | GOL_TILE_CHANGED2 | GOL_TILE_EXPLODED;
+        gol->tile_solved[tile] = gol->generation;
+    }
+    gol->hash = gol_hash_plane(gol, gol->cells);
+}
+
+// Sets up recording the next period generations, to replay them from then
+// on. Returns false when they would take too much memory.
+static bool gol_replay_start(struct gamectx* g, const unsigned long period) {
+    struct gol* gol = &g->gol;
+    const size_t nwords = gol_plane_words(gol, gol->cell_nv);
+    const size_t ntiles = (size_t)gol->word_nh * gol->tile_nv;
+    if (period * ((nwords * sizeof(uint64_t)) + ntiles) > GOL_REPLAY_MEMORY) {
+        return false;
+    }
+    g->cycle.replay.planes = aligned_alloc(GOL_CACHE_LINE, period * nwords * sizeof(uint64_t));
+    g->cycle.replay.tiles = malloc(period * ntiles);
+    if (g->cycle.replay.planes == NULL || g->cycle.replay.tiles == NULL) {
+        free(g->cycle.replay.planes);
+        free(g->cycle.replay.tiles);
+        g->cycle.replay.planes = NULL;
+        g->cycle.replay.tiles = NULL;
+        return false;
     }
-    for (int i = 0; i < (gol->cell_nh * gol->cell_nv); i++) {
-        if ((gol->cell_array[i] & CELL_KILL) != 0) {
-            gol->cell_array[i] = 0;
+    g->cycle.replay.period = period;
+    g->cycle.replay.recorded = 0;
+    g->cycle.replay.hash = gol->hash;
+    return true;
+}
+
+// Drops what was recorded. When it was being replayed, the generation shown
+// and the one before are copied back into the game's own planes, which the
+// grid goes on from.
+static void gol_replay_stop(struct gamectx* g) {
+    struct gol* gol = &g->gol;
+    if (g->cycle.replay.planes == NULL) {
+        return;
+    }
+    if (g->cycle.replay.cells != NULL) {
+        const size_t nwords = gol_plane_words(gol, gol->cell_nv);
+        const size_t ntiles = (size_t)gol->word_nh * gol->tile_nv;
+        const size_t origin = gol_plane_origin(gol);
+        memcpy(g->cycle.replay.cells - origin, gol->cells - origin, nwords * sizeof(uint64_t));
+        memcpy(g->cycle.replay.next - origin, gol->next - origin, nwords * sizeof(uint64_t));
+        memcpy(g->cycle.replay.own_tiles, gol->tiles, ntiles);
+        // the ages and sleeping tiles stood still while replaying
+        for (size_t t = 0; t < ntiles; t++) {
+            g->cycle.replay.own_tiles[t] |= GOL_TILE_CHANGED | GOL_TILE_CHANGED2;
         }
-        if ((gol->cell_array[i] & CELL_BORN) != 0) {
-            gol->cell_array[i] &= ~CELL_BORN;
-            gol->cell_array[i] |= CELL_ALIVE;
+        gol->cells = g->cycle.replay.cells;
+        gol->next = g->cycle.replay.next;
+        gol->tiles = g->cycle.replay.own_tiles;
+        g->cycle.replay.cells = NULL;
+        g->cycle.replay.next = NULL;
+        g->cycle.replay.own_tiles = NULL;
+    }
+    free(g->cycle.replay.planes);
+    free(g->cycle.replay.tiles);
+    g->cycle.replay.planes = NULL;
+    g->cycle.replay.tiles = NULL;
+    g->cycle.valid = g->cycle.updates;
+    g->cycle.period = 0;
+}
+
+// Keeps a copy of the generation just computed. Once a whole period has been
+// recorded, and it did come back to where it started, the generations are
+// replayed instead of computed.
+static void gol_replay_record(struct gamectx* g) {
+    struct gol* gol = &g->gol;
+    const size_t nwords = gol_plane_words(gol, gol->cell_nv);
+    const size_t ntiles = (size_t)gol->word_nh * gol->tile_nv;
+    const unsigned long k = g->cycle.replay.recorded++;
+    memcpy(g->cycle.replay.planes + (k * nwords), gol->cells - gol_plane_origin(gol), nwords * sizeof(uint64_t));
+    memcpy(g->cycle.replay.tiles + (k * ntiles), gol->tiles, ntiles);
+    if (g->cycle.replay.recorded < g->cycle.replay.period) {
+        return;
+    }
+    if (gol->hash != g->cycle.replay.hash) {
+        // not a cycle after all
+        gol_replay_stop(g);
+        return;
+    }
+    g->cycle.replay.index = k;
+    g->cycle.replay.cells = gol->cells;
+    g->cycle.replay.next = gol->next;
+    g->cycle.replay.own_tiles = gol->tiles;
+}
+
+// Generations one update of the game moves on.
+static unsigned long gol_game_step(const struct gamectx* g) {
+    return (g->hashlife.universe != NULL) ? (1UL << g->hashlife.step_log2) : 1;
+}
+
+// Moves on to the next recorded generation. The back buffer is the one
+// before, as after gol_solve(), so the changed cells are found the same way.
+static void gol_replay_step(struct gamectx* g) {
+    struct gol* gol = &g->gol;
+    const size_t nwords = gol_plane_words(gol, gol->cell_nv);
+    const size_t ntiles = (size_t)gol->word_nh * gol->tile_nv;
+    const unsigned long previous = g->cycle.replay.index;
+    g->cycle.replay.index = (previous + 1) % g->cycle.replay.period;
+    gol->next = g->cycle.replay.planes + (previous * nwords) + gol_plane_origin(gol);
+    gol->cells = g->cycle.replay.planes + (g->cycle.replay.index * nwords) + gol_plane_origin(gol);
+    gol->tiles = g->cycle.replay.tiles + (g->cycle.replay.index * ntiles);
+    gol->generation += gol_game_step(g);
+}
+
+// Looks for the hash of the current generation among the last ones. When the
+// generations have been repeating with the same period for another whole
+// period, the grid is in a cycle. With rule 5, the ages of the cells are part
+// of the state too, but they repeat as well once no cell survived a whole
+// GOL_EXPLODE_AGE generations of the cycle, which it would not without
+// exploding and breaking it.
+static void gol_cycle_check(struct gamectx* g) {
+    struct gol* gol = &g->gol;
+    const unsigned long u = g->cycle.updates;
+    const unsigned long known = u - g->cycle.valid;
+
+    if (g->cycle.period == 0 || g->cycle.history[(u - g->cycle.period) % GOL_CYCLE_HISTORY] != gol->hash) {
+        g->cycle.period = 0;
+        for (unsigned long p = 1; p < GOL_CYCLE_HISTORY && p <= known; p++) {
+            if (g->cycle.history[(u - p) % GOL_CYCLE_HISTORY] == gol->hash) {
+                g->cycle.period = p;
+                g->cycle.since = u;
+                break;
+            }
         }
     }
+    g->cycle.history[u % GOL_CYCLE_HISTORY] = gol->hash;
+    g->cycle.updates++;
+
+    const unsigned long period = g->cycle.period;
+    const unsigned long confirm = period + (gol->aging ? GOL_EXPLODE_AGE : 0);
+    if (period == 0 || u - g->cycle.since < confirm) {
+        return;
+    }
+
+    if (g->cycle.policy == GOL_STAGNATION_RESEED) {
+        gol_reseed(gol);
+        if (g->hashlife.universe != NULL) {
+            gol_hashlife_load(g->hashlife.universe, gol->cells, gol->stride);
+        }
+        g->cycle.valid = g->cycle.updates;
+        g->cycle.period = 0;
+    } else if (!gol_replay_start(g, period)) {
+        fprintf(stderr, "[i3lock] gol: a cycle of %lu generations does not fit in memory, "
+                        "computing it on\n", period);
+        g->cycle.policy = GOL_STAGNATION_OFF;
+        gol->hashing = false;
+    }
 }
 
 bool gol_cell_is_alive(const int col, const int line) {
-    return gol_cell_is_alive_(&_g.gol, col, line);
+    return gol_cell_is_alive_(&_g->gol, col, line);
+}
+
+static void gol_init_game(struct gamectx* g, const unsigned int width, const unsigned int height, const double dpi) {
+    const int size = (g->grid.size > 0) ? g->grid.size : GOL_CELL_SIZE;
+    g->display.width = width;
+    g->display.height = height;
+    if (g->grid.cols > 0 && g->grid.rows > 0) {
+        const int fit_h = g->display.width / g->grid.cols;
+        const int fit_v = g->display.height / g->grid.rows;
+        g->grid.size = (fit_h < fit_v) ? fit_h : fit_v;
+    } else {
+        g->grid.size = (dpi > 0) ? (int)((size * dpi / GOL_CELL_DPI) + 0.5) : size;
+    }
+    // a cell bigger than the screen would leave no row or column to play
+    // on, so it is shrunk to fit
+    const unsigned int fit = (width < height) ? width : height;
+    if ((unsigned int)g->grid.size > fit) {
+        g->grid.size = fit;
+    }
+    if (g->grid.size < 1) {
+        g->grid.size = 1;
+    }
+    g->grid.nh = g->display.width / g->grid.size;
+    g->grid.nv = g->display.height / g->grid.size;
+    if (g->grid.cols > 0 && g->grid.rows > 0) {
+        g->grid.nh = (g->grid.cols < g->grid.nh) ? g->grid.cols : g->grid.nh;
+        g->grid.nv = (g->grid.rows < g->grid.nv) ? g->grid.rows : g->grid.nv;
+    }
+    // the engine wraps around the last row and column, it needs one of each
+    if (g->grid.nh < 1) {
+        g->grid.nh = 1;
+    }
+    if (g->grid.nv < 1) {
+        g->grid.nv = 1;
+    }
+    gol_create(&g->gol, g->grid.nh, g->grid.nv, (g->density > 0) ? g->density : 0.5);
+    g->gol.aging = !g->no_explode;
+    if (!g->has_rule) {
+        gol_rule_parse(GOL_RULE_CONWAY, &g->rule);
+    }
+    gol_rule_format(&g->rule, g->rule_name);
+    g->gol.rule = g->rule;
+    g->gol.kernel = gol_kernel_select(&g->rule, g->kernel);
+    if (g->gol.kernel->row == gol_kernel_lut) {
+        gol_lut_build(&g->rule);
+    }
+    gol_pool_init(&g->pool, &g->gol, g->threads);
+    if (g->hashlife.enabled) {
+        if (g->hashlife.memory_limit == 0) {
+            g->hashlife.memory_limit = GOL_HASHLIFE_MEMORY;
+        }
+        g->hashlife.universe = gol_hashlife_create(g->grid.nh, g->grid.nv, g->hashlife.step_log2,
+                                                   g->hashlife.memory_limit, g->rule.born, g->rule.survive);
+        gol_hashlife_load(g->hashlife.universe, g->gol.cells, g->gol.stride);
+        // HashLife's plane goes on past the screen, and what left it can come
+        // back, so the screen repeating is no cycle to replay
+        if (g->cycle.policy == GOL_STAGNATION_REPLAY) {
+            g->cycle.policy = GOL_STAGNATION_OFF;
+        }
+    }
+    if (g->cycle.policy != GOL_STAGNATION_OFF) {
+        g->gol.hashing = true;
+        g->gol.hash = gol_hash_plane(&g->gol, g->gol.cells);
+    }
+}
+
+// Stops and frees the game, which is left as it was before gol_init_game().
+static void gol_destroy_game(struct gamectx* g, const struct gamectx* settings) {
+    gol_replay_stop(g);
+    gol_pool_free(&g->pool);
+    gol_hashlife_destroy(g->hashlife.universe);
+    gol_free(&g->gol);
+    *g = *settings;
 }
 
 void gol_init(unsigned int width, unsigned int height, unsigned int *cols, unsigned int *rows, unsigned int *grid) {
-    _g.display.width = width;
-    _g.display.height = height;
-    _g.grid.size = 10;
-    _g.grid.nh = _g.display.width / _g.grid.size;
-    _g.grid.nv = _g.display.height / _g.grid.size;
-    gol_create(&_g.gol, _g.grid.nh, _g.grid.nv);
+    gol_init_screens(1, &width, &height, NULL);
+    gol_grid(cols, rows, grid);
+}
 
-    *cols = _g.grid.nh;
-    *rows = _g.grid.nv;
-    *grid = _g.grid.size;
+int gol_init_screens(const int nscreens, const unsigned int *widths, const unsigned int *heights, const double *dpis) {
+    gol_destroy();
+    _settings = _games[0];
+    _ngames = (nscreens < GOL_MAX_SCREENS) ? nscreens : GOL_MAX_SCREENS;
+    if (_ngames < 1) {
+        _ngames = 1;
+    }
+    for (int i = 0; i < _ngames; i++) {
+        _games[i] = _settings;
+        gol_init_game(&_games[i], widths[i], heights[i], (dpis != NULL) ? dpis[i] : 0);
+    }
+    _g = &_games[0];
+    _initialized = true;
+    return _ngames;
+}
+
+void gol_destroy(void) {
+    if (!_initialized) {
+        return;
+    }
+    for (int i = 0; i < _ngames; i++) {
+        gol_destroy_game(&_games[i], &_settings);
+    }
+    _ngames = 1;
+    _g = &_games[0];
+    _initialized = false;
+}
+
+void gol_select(const int screen) {
+    _g = &_games[(screen >= 0 && screen < _ngames) ? screen : 0];
+}
+
+void gol_grid(unsigned int *cols, unsigned int *rows, unsigned int *size) {
+    *cols = _g->grid.nh;
+    *rows = _g->grid.nv;
+    *size = _g->grid.size;
+}
+
+void gol_set_threads(const int nthreads) {
+    _g->threads = nthreads;
+}
+
+int gol_threads(void) {
+    return (_g->hashlife.universe != NULL) ? 1 : _g->pool.nthreads;
+}
+
+bool gol_set_kernel(const char* name) {
+    const struct gol_kernel* kernel = gol_kernel_find(name);
+    if (kernel == NULL || !gol_kernel_supported(kernel)) {
+        return false;
+    }
+    _g->kernel = kernel->name;
+    return true;
+}
+
+const char* gol_kernel_name(void) {
+    return _g->gol.kernel->name;
+}
+
+void gol_set_cell_size(const int size) {
+    _g->grid.size = size;
+}
+
+void gol_set_grid(const int cols, const int rows) {
+    _g->grid.cols = cols;
+    _g->grid.rows = rows;
+}
+
+bool gol_set_rule(const char* rulestring) {
+    struct gol_rule rule;
+    if (!gol_rule_parse(rulestring, &rule)) {
+        return false;
+    }
+    _g->rule = rule;
+    _g->has_rule = true;
+    return true;
+}
+
+const char* gol_rule_name(void) {
+    return _g->rule_name;
+}
+
+void gol_set_density(const double density) {
+    _g->density = density;
+}
+
+void gol_set_explode(const bool explode) {
+    _g->no_explode = !explode;
+}
+
+void gol_set_hashlife(const int step_log2) {
+    _g->hashlife.enabled = true;
+    _g->hashlife.step_log2 = step_log2;
+}
+
+void gol_set_hashlife_memory(const size_t bytes) {
+    _g->hashlife.memory_limit = bytes;
+}
+
+static void gol_update_game(struct gamectx* g) {
+    if (g->cycle.replay.planes != NULL && g->cycle.replay.recorded == g->cycle.replay.period) {
+        gol_replay_step(g);
+        return;
+    }
+    if (g->hashlife.universe != NULL) {
+        gol_solve_hashlife(&g->gol, g->hashlife.universe, g->hashlife.step_log2);
+    } else {
+        gol_solve(&g->pool);
+    }
+    if (g->cycle.replay.planes != NULL) {
+        gol_replay_record(g);
+    } else if (g->gol.hashing) {
+        const double start = gol_now();
+        gol_cycle_check(g);
+        g->cycle.seconds += gol_now() - start;
+    }
 }
 
 void gol_update(void) {
-        gol_solve(&_g.gol);
+    for (int i = 0; i < _ngames; i++) {
+        gol_update_game(&_games[i]);
+    }
+}
+
+void gol_set_stagnation(const enum gol_stagnation policy) {
+    _g->cycle.policy = policy;
+    if (policy != GOL_STAGNATION_REPLAY) {
+        gol_replay_stop(_g);
+    }
+    if (policy == GOL_STAGNATION_OFF) {
+        _g->gol.hashing = false;
+    }
+}
+
+double gol_cycle_seconds(void) {
+    double seconds = 0;
+    for (int i = 0; i < _ngames; i++) {
+        seconds += _games[i].gol.hash_seconds + _games[i].cycle.seconds;
+    }
+    return seconds;
+}
+
+double gol_halo_seconds(void) {
+    double seconds = 0;
+    for (int i = 0; i < _ngames; i++) {
+        seconds += _games[i].gol.halo_seconds;
+    }
+    return seconds;
+}
+
+unsigned long gol_cycle_period(void) {
+    if (_g->cycle.replay.planes != NULL && _g->cycle.replay.recorded == _g->cycle.replay.period) {
+        return _g->cycle.replay.period;
+    }
+    return 0;
+}
+
+unsigned long gol_step(void) {
+    return gol_game_step(_g);
+}
+
+unsigned long gol_generation(void) {
+    return _g->gol.generation;
+}
+
+int gol_next_changed(const int col, const int line) {
+    return gol_next_changed_(&_g->gol, col, line);
+}
+
+int gol_tile_cols(void) {
+    return GOL_WORD_BITS;
+}
+
+int gol_tile_lines(void) {
+    return GOL_TILE_LINES;
+}
+
+bool gol_tile_changed(const int col, const int line) {
+    struct gol* gol = &_g->gol;
+    if (col < 0 || col >= gol->cell_nh || line < 0 || line >= gol->cell_nv) {
+        return false;
+    }
+    return (gol->tiles[((line / GOL_TILE_LINES) * gol->word_nh) + (col / GOL_WORD_BITS)] & GOL_TILE_CHANGED) != 0;
+}
+
+const uint64_t* gol_line(const int line) {
+    return gol_row(&_g->gol, _g->gol.cells, line);
+}
+
+const uint64_t* gol_line_before(const int line) {
+    return gol_row(&_g->gol, _g->gol.next, line);
 }
@@ -2,7 +2,106 @@
 #define GOL_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 bool gol_cell_is_alive(const int col, const int line);
 void gol_init(unsigned int width, unsigned int height, unsigned int *cols, unsigned int *rows, unsigned int *grid);
+// Same as gol_init(), but with one independent game per screen of the given
+// size in pixels, with cells as wide in inches on all of them: the cell size
+// is for 96 DPI, a dpi of 0 means unknown and keeps it as it is. Returns how
+// many games there are, at most 16, and selects the first. Called again, for
+// screens that changed, it frees the games and starts new ones with the
+// settings made before the first call.
+int gol_init_screens(const int nscreens, const unsigned int *widths, const unsigned int *heights, const double *dpis);
+// Stops the worker threads and frees every game. The settings made before
+// gol_init() are kept for the next one.
+void gol_destroy(void);
+// Makes the functions reading the grid work on the game of the given screen.
+void gol_select(const int screen);
+// Size of the grid of the selected game, in cells, and of its cells in pixels.
+void gol_grid(unsigned int *cols, unsigned int *rows, unsigned int *size);
+// Computes the next generation of every game.
 void gol_update(void);
+// Number of generations gol_update() has computed since gol_init().
+unsigned long gol_generation(void);
+// Number of generations each gol_update() advances by.
+unsigned long gol_step(void);
+// First column at or after col on the given line whose cell changed in the
+// last generation, or -1 if there is none.
+int gol_next_changed(const int col, const int line);
+// The grid is computed in tiles of gol_tile_cols() x gol_tile_lines() cells,
+// skipping those around which nothing changes.
+int gol_tile_cols(void);
+int gol_tile_lines(void);
+// Whether any cell of the tile holding the given cell changed in the last
+// generation.
+bool gol_tile_changed(const int col, const int line);
+// The cells of a line, gol_tile_cols() to a word: bit i of word w is column
+// (w * gol_tile_cols()) + i, and bits past the last column are clear. Valid
+// until the next gol_update().
+const uint64_t* gol_line(const int line);
+// The same line a generation before, as the cells of gol_next_changed()
+// changed from. It only differs from gol_line() in changed tiles.
+const uint64_t* gol_line_before(const int line);
+// Number of threads gol_update() splits the grid across, 0 (the default)
+// uses one per online CPU. Must be called before gol_init().
+void gol_set_threads(const int nthreads);
+// Number of threads gol_update() actually computes the selected game with:
+// fewer than asked for on small grids, or when threads failed to start.
+int gol_threads(void);
+// Size of a cell in pixels, 0 (the default) for 10, at 96 DPI with
+// gol_init_screens(). A screen smaller than that gets cells as big as it is.
+// Must be called before gol_init().
+void gol_set_cell_size(const int size);
+// Size of the grid in cells, 0 x 0 (the default) to fit cells of
+// gol_set_cell_size() instead. Cells are then as big as the screen allows,
+// still whole pixels. Must be called before gol_init().
+void gol_set_grid(const int cols, const int rows);
+// Fraction of the cells alive in the initial soup, 0 (the default) for one
+// half. Must be called before gol_init().
+void gol_set_density(const double density);
+// Turns rule 5, old cells exploding, on (the default) or off. Must be called
+// before gol_init().
+void gol_set_explode(const bool explode);
+// Rule of the game in B/S notation, "B3/S23" (Conway's, the default) or any
+// other Life-like rule such as "B36/S23". Rules with B0 are refused. Returns
+// false if the rule cannot be parsed. Must be called before gol_init().
+bool gol_set_rule(const char* rulestring);
+// The rule being played, in canonical B/S notation.
+const char* gol_rule_name(void);
+// Kernel to compute generations with, by the name gol_kernel_name() gives,
+// instead of the fastest one for this CPU and rule: "scalar" or "lut" (4x4
+// block lookups) for instance. It is only used if it plays the rule. Returns
+// false if there is no such kernel or the CPU lacks its instructions. Must be
+// called before gol_init().
+bool gol_set_kernel(const char* name);
+// Name of the neighbour-count kernel picked for this CPU and rule by
+// gol_init().
+const char* gol_kernel_name(void);
+// Runs the game through HashLife (see gol_hashlife.h), 2^step_log2
+// generations per gol_update(), instead of on the wrapping grid. Must be
+// called before gol_init().
+void gol_set_hashlife(const int step_log2);
+// Memory HashLife may use for its nodes before collecting the unused ones,
+// 0 (the default) for 256 MiB. Must be called before gol_init().
+void gol_set_hashlife_memory(const size_t bytes);
+// What to do once the grid settled into a cycle (still lifes and oscillators
+// of up to 63 generations): replay the recorded generations of the cycle
+// instead of computing them (the default), reseed some of the grid, or keep
+// computing it. HashLife only reseeds, its plane goes on past the screen.
+// Must be called before gol_init(); called after, any other policy than
+// replaying ends the replay of a cycle, and the grid is computed on from it.
+enum gol_stagnation {
+    GOL_STAGNATION_REPLAY,
+    GOL_STAGNATION_RESEED,
+    GOL_STAGNATION_OFF,
+};
+void gol_set_stagnation(const enum gol_stagnation policy);
+// Seconds spent looking for cycles since gol_init().
+double gol_cycle_seconds(void);
+// Seconds spent since gol_init() copying the edges of the grid around it, for
+// the cells at the edges to find their neighbours without wrapping.
+double gol_halo_seconds(void);
+// Period of the cycle being replayed, 0 while generations are computed.
+unsigned long gol_cycle_period(void);
 #endif // GOL_H_
@@ -0,0 +1,214 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * gol_bench.c: measures gol_update() on its own, without X11 or PAM.
+ *
+ * Every workload (grid size, density, rule 5 on or off, number of threads)
+ * runs in a forked child, so it starts from a fresh engine and its peak RSS
+ * is its own. Each prints one JSON object per line on stdout.
+ *
+ */
+#include <err.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "gol.h"
+
+struct workload {
+    int cols;
+    int rows;
+    double density;
+    bool explode;
+    int threads;
+};
+
+static const int sizes[][2] = {
+    {192, 108},
+    {480, 270},
+    {960, 540},
+    {1920, 1080},
+    {3840, 2160},
+    {7680, 4320},
+};
+
+static const double densities[] = {0.1, 0.25, 0.5};
+
+static int generations = 100;
+/* --threads, or the range of them to go through with --threads 1-8. */
+static int threads_min = 0;
+static int threads_max = 0;
+static int hashlife = -1;
+static const char *rule = NULL;
+static const char *kernel = NULL;
+static unsigned int seed = 1;
+/* Off unless asked for, so that a settled grid is still computed. */
+static enum gol_stagnation stagnation = GOL_STAGNATION_OFF;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void run(const struct workload *w) {
+    unsigned int cols, rows, size;
+
+    srand(seed);
+    gol_set_cell_size(1);
+    gol_set_density(w->density);
+    gol_set_explode(w->explode);
+    gol_set_threads(w->threads);
+    gol_set_stagnation(stagnation);
+    if (rule != NULL) {
+        gol_set_rule(rule);
+    }
+    if (kernel != NULL) {
+        gol_set_kernel(kernel);
+    }
+    if (hashlife >= 0) {
+        gol_set_hashlife(hashlife);
+    }
+    gol_init(w->cols, w->rows, &cols, &rows, &size);
+
+    /* The first update starts the worker threads, keep it out of the timing. */
+    gol_update();
+
+    const unsigned long first = gol_generation();
+    const double start = now();
+    for (int i = 0; i < generations; i++) {
+        gol_update();
+    }
+    const double seconds = now() - start;
+    const double cells = (double)cols * rows * (gol_generation() - first);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\"cols\": %u, \"rows\": %u, \"density\": %.2f, \"explode\": %s, "
+           "\"rule\": \"%s\", \"engine\": \"%s\", \"threads\": %d, \"generations\": %lu, \"seconds\": %.6f, "
+           "\"cells_per_second\": %.0f, \"ns_per_cell\": %.4f, \"cycle_seconds\": %.6f, "
+           "\"cycle_period\": %lu, \"halo_seconds\": %.6f, \"peak_rss_kib\": %ld}\n",
+           cols, rows, w->density, w->explode ? "true" : "false", gol_rule_name(),
+           (hashlife >= 0) ? "hashlife" : gol_kernel_name(), gol_threads(), gol_generation() - first, seconds,
+           cells / seconds, (seconds * 1e9) / cells, gol_cycle_seconds(), gol_cycle_period(),
+           gol_halo_seconds(), usage.ru_maxrss);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    int max_cells = 7680 * 4320;
+    int o;
+    struct option longopts[] = {
+        {"generations", required_argument, NULL, 'g'},
+        {"threads", required_argument, NULL, 't'},
+        {"seed", required_argument, NULL, 's'},
+        {"max-cells", required_argument, NULL, 'm'},
+        {"hashlife", required_argument, NULL, 'H'},
+        {"stagnation", required_argument, NULL, 'S'},
+        {"rule", required_argument, NULL, 'r'},
+        {"kernel", required_argument, NULL, 'k'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, no_argument, NULL, 0}};
+
+    while ((o = getopt_long(argc, argv, "g:t:s:m:H:S:r:k:h", longopts, NULL)) != -1) {
+        switch (o) {
+            case 'g':
+                if (sscanf(optarg, "%d", &generations) != 1 || generations < 1) {
+                    errx(EXIT_FAILURE, "generations must be a positive number");
+                }
+                break;
+            case 't':
+                if (sscanf(optarg, "%d-%d", &threads_min, &threads_max) == 2) {
+                    if (threads_min < 1 || threads_max < threads_min) {
+                        errx(EXIT_FAILURE, "threads must be a range of at least one thread, e.g. 1-8");
+                    }
+                } else if (sscanf(optarg, "%d", &threads_min) != 1 || threads_min < 0) {
+                    errx(EXIT_FAILURE, "threads must be a number of threads (0 for one per CPU), or a range of them");
+                } else {
+                    threads_max = threads_min;
+                }
+                break;
+            case 's':
+                if (sscanf(optarg, "%u", &seed) != 1) {
+                    errx(EXIT_FAILURE, "seed must be a number");
+                }
+                break;
+            case 'm':
+                if (sscanf(optarg, "%d", &max_cells) != 1 || max_cells < 1) {
+                    errx(EXIT_FAILURE, "max-cells must be a positive number");
+                }
+                break;
+            case 'H':
+                if (sscanf(optarg, "%d", &hashlife) != 1 || hashlife < 0 || hashlife > 16) {
+                    errx(EXIT_FAILURE, "hashlife must be the log2 of the generations per step, 0 to 16");
+                }
+                break;
+            case 'S':
+                if (!strcmp(optarg, "replay")) {
+                    stagnation = GOL_STAGNATION_REPLAY;
+                } else if (!strcmp(optarg, "reseed")) {
+                    stagnation = GOL_STAGNATION_RESEED;
+                } else if (!strcmp(optarg, "off")) {
+                    stagnation = GOL_STAGNATION_OFF;
+                } else {
+                    errx(EXIT_FAILURE, "stagnation must be one of replay, reseed or off");
+                }
+                break;
+            case 'r':
+                if (!gol_set_rule(optarg)) {
+                    errx(EXIT_FAILURE, "rule must be given as B/S digits without B0, e.g. B36/S23");
+                }
+                rule = optarg;
+                break;
+            case 'k':
+                if (!gol_set_kernel(optarg)) {
+                    errx(EXIT_FAILURE, "kernel must be one this CPU can run, e.g. scalar or lut");
+                }
+                kernel = optarg;
+                break;
+            default:
+                errx(EXIT_FAILURE, "Syntax: gol-bench [-g generations] [-t threads|min-max] [-s seed] "
+                                   "[-m max-cells] [-H hashlife-step-log2] [-S replay|reseed|off] [-r rule] "
+                                   "[-k kernel]");
+        }
+    }
+
+    const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    const int ndensities = sizeof(densities) / sizeof(densities[0]);
+    bool failed = false;
+    for (int s = 0; s < nsizes; s++) {
+        if ((long)sizes[s][0] * sizes[s][1] > max_cells) {
+            continue;
+        }
+        for (int d = 0; d < ndensities; d++) {
+            /* HashLife has no rule 5 to turn on. */
+            for (int e = (hashlife >= 0) ? 0 : 1; e >= 0; e--) {
+                for (int t = threads_min; t <= threads_max; t++) {
+                    const struct workload w = {sizes[s][0], sizes[s][1], densities[d], e == 1, t};
+                    pid_t pid = fork();
+                    if (pid == -1) {
+                        err(EXIT_FAILURE, "fork");
+                    }
+                    if (pid == 0) {
+                        run(&w);
+                        exit(EXIT_SUCCESS);
+                    }
+                    int status;
+                    if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                        warnx("workload %dx%d density %.2f explode %d threads %d failed", w.cols, w.rows, w.density,
+                              w.explode, w.threads);
+                        failed = true;
+                    }
+                }
+            }
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * gol_check.c: runs the simulation on screens it could get wrong, without
+ * X11 or PAM, and fails when a screen gets no grid to play on.
+ *
+ */
+#include <err.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gol.h"
+
+#define MAX_SCREENS 2
+
+struct screens {
+    const char *name;
+    int cell_size;
+    int n;
+    unsigned int widths[MAX_SCREENS];
+    unsigned int heights[MAX_SCREENS];
+    /* 0 for a screen of unknown DPI, whose cells are cell_size pixels. */
+    double dpis[MAX_SCREENS];
+};
+
+static const struct screens checks[] = {
+    {"screen smaller than one cell", 10, 1, {5}, {5}, {0}},
+    {"screen one pixel wide", 10, 1, {1}, {1080}, {0}},
+    /* Only the DPI scaling makes cells bigger than the second screen. */
+    {"small dense screen next to a large one", 10, 2, {1920, 16}, {1080, 16}, {96, 384}},
+};
+
+/*
+ * Runs a few generations on every screen of c, and returns whether each of
+ * them had a whole row and column of cells that fit it.
+ *
+ */
+static bool check(const struct screens *c) {
+    unsigned int cols, rows, size;
+    bool ok = true;
+
+    gol_set_cell_size(c->cell_size);
+    gol_set_explode(true);
+    gol_set_threads(1);
+    gol_init_screens(c->n, c->widths, c->heights, c->dpis);
+    for (int screen = 0; screen < c->n; screen++) {
+        gol_select(screen);
+        gol_grid(&cols, &rows, &size);
+        if (cols < 1 || rows < 1 || size > c->widths[screen] || size > c->heights[screen]) {
+            warnx("%s: a %ux%u screen at %.0f DPI got a %ux%u grid of %u px cells", c->name, c->widths[screen],
+                  c->heights[screen], c->dpis[screen], cols, rows, size);
+            ok = false;
+        }
+        for (int i = 0; i < 10; i++) {
+            gol_update();
+        }
+    }
+    gol_destroy();
+    return ok;
+}
+
+int main(void) {
+    const int nchecks = sizeof(checks) / sizeof(checks[0]);
+    bool failed = false;
+    for (int i = 0; i < nchecks; i++) {
+        if (!check(&checks[i])) {
+            failed = true;
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
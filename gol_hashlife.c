@@ -0,0 +1,532 @@
+#include "gol_hashlife.h"
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// Leaves are level 3 nodes holding 8x8 cells, line y in byte y and column x
+// in bit x of that byte. A node of level n covers 2^n x 2^n cells.
+#define GOL_HL_LEAF_LEVEL 3
+#define GOL_HL_MAX_LEVEL 62
+#define GOL_HL_SLAB_NODES 4096
+
+enum { GOL_HL_NW, GOL_HL_NE, GOL_HL_SW, GOL_HL_SE };
+
+struct gol_node {
+    struct gol_node* child[4];  // NULL for leaves
+    struct gol_node* result;    // memoized gol_hl_successor()
+    struct gol_node* next;      // hash chain, or free list
+    uint64_t bits;              // cells of a leaf
+    int level;
+    bool marked;
+};
+
+struct gol_hashlife {
+    int width;
+    int height;
+    int step_log2;
+    size_t memory_limit;
+    // the node store is collected once it grows past this, memory_limit
+    // unless what the root uses alone is more than that
+    size_t collect_at;
+    // the rule, bit k set for k neighbours, see gol_set_rule()
+    uint16_t born;
+    uint16_t survive;
+    bool over_limit;
+    // cells further than this from the window are dropped
+    int64_t margin;
+    // roots above this level are pruned and shrunk after each step
+    int prune_level;
+
+    // hash-consed node store, every distinct node exists exactly once
+    struct gol_node** buckets;
+    size_t nbuckets;
+    size_t nnodes;
+    struct gol_node* free_nodes;
+    struct gol_node** slabs;
+    size_t nslabs;
+    struct gol_node* empty[GOL_HL_MAX_LEVEL + 1];
+
+    struct gol_node* root;
+    // position of the root's north-west corner, in window coordinates
+    int64_t x;
+    int64_t y;
+};
+
+static inline uint64_t gol_hl_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t gol_hl_hash(struct gol_node* const child[4], const uint64_t bits) {
+    uint64_t h = gol_hl_mix(bits);
+    for (int i = 0; i < 4; i++) {
+        h = gol_hl_mix(h ^ (uintptr_t)child[i]);
+    }
+    return h;
+}
+
+static size_t gol_hl_memory(struct gol_hashlife* hl) {
+    return (hl->nnodes * sizeof(struct gol_node)) + (hl->nbuckets * sizeof(struct gol_node*));
+}
+
+static struct gol_node* gol_hl_alloc(struct gol_hashlife* hl) {
+    if (hl->free_nodes == NULL) {
+        struct gol_node* slab = calloc(GOL_HL_SLAB_NODES, sizeof(struct gol_node));
+        struct gol_node** slabs = realloc(hl->slabs, (hl->nslabs + 1) * sizeof(struct gol_node*));
+        if (slab == NULL || slabs == NULL) {
+            fprintf(stderr, "gol: out of memory for HashLife nodes\n");
+            exit(EXIT_FAILURE);
+        }
+        hl->slabs = slabs;
+        hl->slabs[hl->nslabs++] = slab;
+        for (int i = 0; i < GOL_HL_SLAB_NODES; i++) {
+            slab[i].next = hl->free_nodes;
+            hl->free_nodes = &slab[i];
+        }
+    }
+    struct gol_node* node = hl->free_nodes;
+    hl->free_nodes = node->next;
+    return node;
+}
+
+static void gol_hl_rehash(struct gol_hashlife* hl, const size_t nbuckets) {
+    struct gol_node** buckets = calloc(nbuckets, sizeof(struct gol_node*));
+    if (buckets == NULL) {
+        fprintf(stderr, "gol: out of memory for HashLife nodes\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t b = 0; b < hl->nbuckets; b++) {
+        struct gol_node* node = hl->buckets[b];
+        while (node != NULL) {
+            struct gol_node* next = node->next;
+            size_t i = gol_hl_hash(node->child, node->bits) & (nbuckets - 1);
+            node->next = buckets[i];
+            buckets[i] = node;
+            node = next;
+        }
+    }
+    free(hl->buckets);
+    hl->buckets = buckets;
+    hl->nbuckets = nbuckets;
+}
+
+// returns the one node with these children (or leaf bits), creating it if needed
+static struct gol_node* gol_hl_find(struct gol_hashlife* hl, struct gol_node* const child[4], const uint64_t bits) {
+    size_t i = gol_hl_hash(child, bits) & (hl->nbuckets - 1);
+    for (struct gol_node* node = hl->buckets[i]; node != NULL; node = node->next) {
+        if (node->bits == bits && memcmp(node->child, child, sizeof(node->child)) == 0) {
+            return node;
+        }
+    }
+
+    struct gol_node* node = gol_hl_alloc(hl);
+    memcpy(node->child, child, sizeof(node->child));
+    node->bits = bits;
+    node->level = (child[0] == NULL) ? GOL_HL_LEAF_LEVEL : child[0]->level + 1;
+    node->result = NULL;
+    node->marked = false;
+    node->next = hl->buckets[i];
+    hl->buckets[i] = node;
+    if (++hl->nnodes > hl->nbuckets) {
+        gol_hl_rehash(hl, hl->nbuckets * 2);
+    }
+    return node;
+}
+
+static struct gol_node* gol_hl_leaf(struct gol_hashlife* hl, const uint64_t bits) {
+    struct gol_node* const child[4] = {NULL, NULL, NULL, NULL};
+    return gol_hl_find(hl, child, bits);
+}
+
+static struct gol_node* gol_hl_node(struct gol_hashlife* hl, struct gol_node* nw, struct gol_node* ne,
+                                    struct gol_node* sw, struct gol_node* se) {
+    struct gol_node* const child[4] = {nw, ne, sw, se};
+    return gol_hl_find(hl, child, 0);
+}
+
+static struct gol_node* gol_hl_empty(struct gol_hashlife* hl, const int level) {
+    if (hl->empty[level] == NULL) {
+        if (level == GOL_HL_LEAF_LEVEL) {
+            hl->empty[level] = gol_hl_leaf(hl, 0);
+        } else {
+            struct gol_node* e = gol_hl_empty(hl, level - 1);
+            hl->empty[level] = gol_hl_node(hl, e, e, e, e);
+        }
+    }
+    return hl->empty[level];
+}
+
+// lines of the 16x16 cells of a level 4 node, column x in bit x
+static void gol_hl_lines(const struct gol_node* m, uint32_t lines[16]) {
+    for (int y = 0; y < 8; y++) {
+        lines[y] = ((m->child[GOL_HL_NW]->bits >> (8 * y)) & 0xff) |
+                   (((m->child[GOL_HL_NE]->bits >> (8 * y)) & 0xff) << 8);
+        lines[y + 8] = ((m->child[GOL_HL_SW]->bits >> (8 * y)) & 0xff) |
+                       (((m->child[GOL_HL_SE]->bits >> (8 * y)) & 0xff) << 8);
+    }
+}
+
+// the middle 8x8 cells of 16 lines as leaf bits
+static uint64_t gol_hl_middle(const uint32_t lines[16]) {
+    uint64_t bits = 0;
+    for (int y = 0; y < 8; y++) {
+        bits |= (uint64_t)((lines[y + 4] >> 4) & 0xff) << (8 * y);
+    }
+    return bits;
+}
+
+// the rule for a line of up to 16 cells, counting the 8 neighbours with a
+// bit-sliced adder into s0 to s3, then matching each count the rule has an
+// entry for
+static inline uint32_t gol_hl_life_line(const struct gol_hashlife* hl, const uint32_t up, const uint32_t mid,
+                                        const uint32_t down) {
+    const uint32_t n[8] = {up << 1, up, up >> 1, mid << 1, mid >> 1, down << 1, down, down >> 1};
+    uint32_t s[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 8; i++) {
+        uint32_t carry = n[i];
+        for (int b = 0; b < 4 && carry != 0; b++) {
+            const uint32_t c = s[b] & carry;
+            s[b] ^= carry;
+            carry = c;
+        }
+    }
+    uint32_t out = 0;
+    for (int k = 0; k <= 8; k++) {
+        const bool born = (hl->born >> k) & 1;
+        const bool survive = (hl->survive >> k) & 1;
+        if (!born && !survive) {
+            continue;
+        }
+        uint32_t match = ~0u;
+        for (int b = 0; b < 4; b++) {
+            match &= ((k >> b) & 1) ? s[b] : ~s[b];
+        }
+        out |= match & (born ? ~0u : mid) & (survive ? ~0u : ~mid);
+    }
+    return out & 0xffff;
+}
+
+// Runs a level 4 node for up to 4 generations and returns its middle, which
+// the cells outside of the node cannot have reached yet.
+static struct gol_node* gol_hl_base(struct gol_hashlife* hl, struct gol_node* m, const int generations) {
+    uint32_t lines[16];
+    uint32_t next[16];
+    gol_hl_lines(m, lines);
+    for (int g = 0; g < generations; g++) {
+        for (int y = 0; y < 16; y++) {
+            next[y] = gol_hl_life_line(hl, (y > 0) ? lines[y - 1] : 0, lines[y], (y < 15) ? lines[y + 1] : 0);
+        }
+        memcpy(lines, next, sizeof(lines));
+    }
+    return gol_hl_leaf(hl, gol_hl_middle(lines));
+}
+
+// the middle half of a node, as it is now
+static struct gol_node* gol_hl_centre(struct gol_hashlife* hl, struct gol_node* m) {
+    if (m->level == GOL_HL_LEAF_LEVEL + 1) {
+        uint32_t lines[16];
+        gol_hl_lines(m, lines);
+        return gol_hl_leaf(hl, gol_hl_middle(lines));
+    }
+    return gol_hl_node(hl, m->child[GOL_HL_NW]->child[GOL_HL_SE], m->child[GOL_HL_NE]->child[GOL_HL_SW],
+                       m->child[GOL_HL_SW]->child[GOL_HL_NE], m->child[GOL_HL_SE]->child[GOL_HL_NW]);
+}
+
+// Returns the middle half of a level n node, 2^j generations later, with
+// j = min(step_log2, n - 2). The nine overlapping sub-nodes of half the size
+// are either advanced by half of that (when going at full speed) or just
+// centred, then regrouped into four nodes which advance the rest of the way.
+static struct gol_node* gol_hl_successor(struct gol_hashlife* hl, struct gol_node* m) {
+    if (m->result != NULL) {
+        return m->result;
+    }
+
+    const int level = m->level;
+    const int j = (hl->step_log2 < level - 2) ? hl->step_log2 : level - 2;
+    struct gol_node* result;
+    if (m == gol_hl_empty(hl, level)) {
+        result = gol_hl_empty(hl, level - 1);
+    } else if (level == GOL_HL_LEAF_LEVEL + 1) {
+        result = gol_hl_base(hl, m, 1 << j);
+    } else {
+        struct gol_node* nw = m->child[GOL_HL_NW];
+        struct gol_node* ne = m->child[GOL_HL_NE];
+        struct gol_node* sw = m->child[GOL_HL_SW];
+        struct gol_node* se = m->child[GOL_HL_SE];
+        struct gol_node* sub[9] = {
+            nw,
+            gol_hl_node(hl, nw->child[GOL_HL_NE], ne->child[GOL_HL_NW], nw->child[GOL_HL_SE], ne->child[GOL_HL_SW]),
+            ne,
+            gol_hl_node(hl, nw->child[GOL_HL_SW], nw->child[GOL_HL_SE], sw->child[GOL_HL_NW], sw->child[GOL_HL_NE]),
+            gol_hl_node(hl, nw->child[GOL_HL_SE], ne->child[GOL_HL_SW], sw->child[GOL_HL_NE], se->child[GOL_HL_NW]),
+            gol_hl_node(hl, ne->child[GOL_HL_SW], ne->child[GOL_HL_SE], se->child[GOL_HL_NW], se->child[GOL_HL_NE]),
+            sw,
+            gol_hl_node(hl, sw->child[GOL_HL_NE], se->child[GOL_HL_NW], sw->child[GOL_HL_SE], se->child[GOL_HL_SW]),
+            se,
+        };
+        struct gol_node* r[9];
+        for (int i = 0; i < 9; i++) {
+            r[i] = (j == level - 2) ? gol_hl_successor(hl, sub[i]) : gol_hl_centre(hl, sub[i]);
+        }
+        result = gol_hl_node(hl,
+                             gol_hl_successor(hl, gol_hl_node(hl, r[0], r[1], r[3], r[4])),
+                             gol_hl_successor(hl, gol_hl_node(hl, r[1], r[2], r[4], r[5])),
+                             gol_hl_successor(hl, gol_hl_node(hl, r[3], r[4], r[6], r[7])),
+                             gol_hl_successor(hl, gol_hl_node(hl, r[4], r[5], r[7], r[8])));
+    }
+    m->result = result;
+    return result;
+}
+
+// surrounds the root with empty space, doubling its size
+static void gol_hl_expand(struct gol_hashlife* hl) {
+    struct gol_node* root = hl->root;
+    struct gol_node* e = gol_hl_empty(hl, root->level - 1);
+    hl->x -= (int64_t)1 << (root->level - 1);
+    hl->y -= (int64_t)1 << (root->level - 1);
+    hl->root = gol_hl_node(hl,
+                           gol_hl_node(hl, e, e, e, root->child[GOL_HL_NW]),
+                           gol_hl_node(hl, e, e, root->child[GOL_HL_NE], e),
+                           gol_hl_node(hl, e, root->child[GOL_HL_SW], e, e),
+                           gol_hl_node(hl, root->child[GOL_HL_SE], e, e, e));
+}
+
+// whether all live cells of the root are in its middle half
+static bool gol_hl_centred(struct gol_hashlife* hl) {
+    struct gol_node* root = hl->root;
+    struct gol_node* e = gol_hl_empty(hl, root->level - 2);
+    struct gol_node* nw = root->child[GOL_HL_NW];
+    struct gol_node* ne = root->child[GOL_HL_NE];
+    struct gol_node* sw = root->child[GOL_HL_SW];
+    struct gol_node* se = root->child[GOL_HL_SE];
+    return nw->child[GOL_HL_NW] == e && nw->child[GOL_HL_NE] == e && nw->child[GOL_HL_SW] == e &&
+           ne->child[GOL_HL_NW] == e && ne->child[GOL_HL_NE] == e && ne->child[GOL_HL_SE] == e &&
+           sw->child[GOL_HL_NW] == e && sw->child[GOL_HL_SW] == e && sw->child[GOL_HL_SE] == e &&
+           se->child[GOL_HL_NE] == e && se->child[GOL_HL_SW] == e && se->child[GOL_HL_SE] == e;
+}
+
+// Drops the cells of a node at (x, y) that are outside of the window plus
+// the margin.
+static struct gol_node* gol_hl_prune(struct gol_hashlife* hl, struct gol_node* node, const int64_t x, const int64_t y) {
+    const int64_t size = (int64_t)1 << node->level;
+    const int64_t x0 = -hl->margin;
+    const int64_t y0 = -hl->margin;
+    const int64_t x1 = hl->width + hl->margin;
+    const int64_t y1 = hl->height + hl->margin;
+    if (node == gol_hl_empty(hl, node->level) || (x >= x0 && y >= y0 && x + size <= x1 && y + size <= y1)) {
+        return node;
+    }
+    if (x >= x1 || y >= y1 || x + size <= x0 || y + size <= y0) {
+        return gol_hl_empty(hl, node->level);
+    }
+
+    if (node->level == GOL_HL_LEAF_LEVEL) {
+        uint64_t bits = node->bits;
+        for (int i = 0; i < 64; i++) {
+            int64_t cx = x + (i % 8);
+            int64_t cy = y + (i / 8);
+            if (cx < x0 || cx >= x1 || cy < y0 || cy >= y1) {
+                bits &= ~(1ULL << i);
+            }
+        }
+        return gol_hl_leaf(hl, bits);
+    }
+    const int64_t half = size / 2;
+    return gol_hl_node(hl,
+                       gol_hl_prune(hl, node->child[GOL_HL_NW], x, y),
+                       gol_hl_prune(hl, node->child[GOL_HL_NE], x + half, y),
+                       gol_hl_prune(hl, node->child[GOL_HL_SW], x, y + half),
+                       gol_hl_prune(hl, node->child[GOL_HL_SE], x + half, y + half));
+}
+
+// drops far away cells, then the empty space around the rest
+static void gol_hl_trim(struct gol_hashlife* hl) {
+    hl->root = gol_hl_prune(hl, hl->root, hl->x, hl->y);
+    while (hl->root->level > GOL_HL_LEAF_LEVEL + 2 && gol_hl_centred(hl)) {
+        const int64_t quarter = (int64_t)1 << (hl->root->level - 2);
+        hl->root = gol_hl_centre(hl, hl->root);
+        hl->x += quarter;
+        hl->y += quarter;
+    }
+}
+
+static void gol_hl_mark(struct gol_node* node) {
+    if (node == NULL || node->marked) {
+        return;
+    }
+    node->marked = true;
+    for (int i = 0; i < 4; i++) {
+        gol_hl_mark(node->child[i]);
+    }
+}
+
+// Frees every node the root does not use. The memoized results go too, as
+// they may point at freed nodes. When what is left is still over the limit,
+// collecting again after every step would throw the results away as fast as
+// they are found, so the next collection waits until the store doubled.
+static void gol_hl_collect(struct gol_hashlife* hl) {
+    gol_hl_trim(hl);
+    gol_hl_mark(hl->root);
+    for (int level = 0; level <= GOL_HL_MAX_LEVEL; level++) {
+        gol_hl_mark(hl->empty[level]);
+    }
+
+    for (size_t b = 0; b < hl->nbuckets; b++) {
+        struct gol_node** link = &hl->buckets[b];
+        while (*link != NULL) {
+            struct gol_node* node = *link;
+            if (node->marked) {
+                node->marked = false;
+                node->result = NULL;
+                link = &node->next;
+            } else {
+                *link = node->next;
+                node->next = hl->free_nodes;
+                hl->free_nodes = node;
+                hl->nnodes--;
+            }
+        }
+    }
+
+    if (gol_hl_memory(hl) <= hl->memory_limit) {
+        hl->collect_at = hl->memory_limit;
+        return;
+    }
+    hl->collect_at = 2 * gol_hl_memory(hl);
+    if (!hl->over_limit) {
+        fprintf(stderr, "gol: the HashLife universe alone needs more than %zu bytes, "
+                        "collecting its nodes at %zu\n", hl->memory_limit, hl->collect_at);
+        hl->over_limit = true;
+    }
+}
+
+struct gol_hashlife* gol_hashlife_create(const int width, const int height, const int step_log2,
+                                         const size_t memory_limit, const uint16_t born, const uint16_t survive) {
+    struct gol_hashlife* hl = calloc(1, sizeof(struct gol_hashlife));
+    hl->born = born;
+    hl->survive = survive;
+    hl->width = width;
+    hl->height = height;
+    hl->step_log2 = step_log2;
+    hl->memory_limit = memory_limit;
+    hl->collect_at = memory_limit;
+    hl->margin = ((width > height) ? width : height) + ((int64_t)1 << step_log2);
+    hl->prune_level = GOL_HL_LEAF_LEVEL + 2;
+    while (((int64_t)1 << hl->prune_level) < 2 * (((width > height) ? width : height) + 2 * hl->margin)) {
+        hl->prune_level++;
+    }
+    hl->nbuckets = 1 << 16;
+    hl->buckets = calloc(hl->nbuckets, sizeof(struct gol_node*));
+    hl->root = gol_hl_empty(hl, GOL_HL_LEAF_LEVEL + 1);
+    return hl;
+}
+
+void gol_hashlife_destroy(struct gol_hashlife* hl) {
+    if (hl == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < hl->nslabs; i++) {
+        free(hl->slabs[i]);
+    }
+    free(hl->slabs);
+    free(hl->buckets);
+    free(hl);
+}
+
+static struct gol_node* gol_hl_build(struct gol_hashlife* hl, const uint64_t* plane, const int stride,
+                                     const int level, const int64_t x, const int64_t y) {
+    if (x >= hl->width || y >= hl->height) {
+        return gol_hl_empty(hl, level);
+    }
+    if (level == GOL_HL_LEAF_LEVEL) {
+        uint64_t bits = 0;
+        for (int r = 0; r < 8 && y + r < hl->height; r++) {
+            uint64_t word = plane[((y + r) * stride) + (x / 64)];
+            bits |= ((word >> (x % 64)) & 0xff) << (8 * r);
+        }
+        return gol_hl_leaf(hl, bits);
+    }
+    const int64_t half = (int64_t)1 << (level - 1);
+    return gol_hl_node(hl,
+                       gol_hl_build(hl, plane, stride, level - 1, x, y),
+                       gol_hl_build(hl, plane, stride, level - 1, x + half, y),
+                       gol_hl_build(hl, plane, stride, level - 1, x, y + half),
+                       gol_hl_build(hl, plane, stride, level - 1, x + half, y + half));
+}
+
+void gol_hashlife_load(struct gol_hashlife* hl, const uint64_t* plane, const int stride) {
+    int level = GOL_HL_LEAF_LEVEL + 1;
+    while ((1 << level) < hl->width || (1 << level) < hl->height) {
+        level++;
+    }
+    hl->root = gol_hl_build(hl, plane, stride, level, 0, 0);
+    hl->x = 0;
+    hl->y = 0;
+}
+
+// Expands the root until its cells cannot reach its edges within a step
+// while the step is as large as the root allows, then replaces it with its
+// middle half 2^step_log2 generations later.
+void gol_hashlife_step(struct gol_hashlife* hl) {
+    int min_level = hl->step_log2 + 3;
+    if (min_level < GOL_HL_LEAF_LEVEL + 2) {
+        min_level = GOL_HL_LEAF_LEVEL + 2;
+    }
+    while (hl->root->level < min_level || !gol_hl_centred(hl)) {
+        gol_hl_expand(hl);
+    }
+    gol_hl_expand(hl);
+
+    const int64_t quarter = (int64_t)1 << (hl->root->level - 2);
+    hl->root = gol_hl_successor(hl, hl->root);
+    hl->x += quarter;
+    hl->y += quarter;
+
+    if (gol_hl_memory(hl) > hl->collect_at) {
+        gol_hl_collect(hl);
+    } else if (hl->root->level > hl->prune_level) {
+        gol_hl_trim(hl);
+    }
+}
+
+static void gol_hl_store_node(struct gol_hashlife* hl, struct gol_node* node, uint64_t* plane, const int stride,
+                              const int64_t x, const int64_t y) {
+    const int64_t size = (int64_t)1 << node->level;
+    if (x >= hl->width || y >= hl->height || x + size <= 0 || y + size <= 0 ||
+        node == gol_hl_empty(hl, node->level)) {
+        return;
+    }
+    if (node->level == GOL_HL_LEAF_LEVEL) {
+        for (int r = 0; r < 8; r++) {
+            if (y + r >= 0 && y + r < hl->height) {
+                plane[((y + r) * stride) + (x / 64)] |= ((node->bits >> (8 * r)) & 0xff) << (x % 64);
+            }
+        }
+        return;
+    }
+    const int64_t half = size / 2;
+    gol_hl_store_node(hl, node->child[GOL_HL_NW], plane, stride, x, y);
+    gol_hl_store_node(hl, node->child[GOL_HL_NE], plane, stride, x + half, y);
+    gol_hl_store_node(hl, node->child[GOL_HL_SW], plane, stride, x, y + half);
+    gol_hl_store_node(hl, node->child[GOL_HL_SE], plane, stride, x + half, y + half);
+}
+
+void gol_hashlife_store(struct gol_hashlife* hl, uint64_t* plane, const int stride) {
+    const int words = (hl->width + 63) / 64;
+    for (int line = 0; line < hl->height; line++) {
+        memset(plane + (line * stride), 0, sizeof(uint64_t) * words);
+    }
+    gol_hl_store_node(hl, hl->root, plane, stride, hl->x, hl->y);
+
+    // leaves sticking out of the right edge leave cells past the last column
+    const uint64_t last_mask = ~0ULL >> ((64 - (hl->width % 64)) % 64);
+    for (int line = 0; line < hl->height; line++) {
+        plane[(line * stride) + words - 1] &= last_mask;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef GOL_HASHLIFE_H_
+#define GOL_HASHLIFE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// HashLife: the grid as a quadtree of hash-consed nodes, each of which
+// remembers its own future, so repetitive regions are computed once.
+//
+// Unlike the plane engine in gol.c, this one works on an unbounded plane:
+// nothing wraps around the edges of the window. Cells that wander off the
+// window keep evolving until they are more than a margin away from it, then
+// they are dropped. There is no age rule (rule 5) either, since a cell's
+// future would then depend on more than its neighbourhood; only the B/S rule
+// applies. Rules with B0 cannot be played, empty space would not stay empty.
+struct gol_hashlife;
+
+// Creates an empty universe showing a window of width x height cells, which
+// gol_hashlife_step() advances by 2^step_log2 generations at a time. The
+// node store is garbage collected whenever it grows past memory_limit bytes,
+// or past twice what was left after the last collection if that was more.
+// Bit k of born and survive is set when a dead cell with k live neighbours
+// comes to life, and when a live one stays alive.
+struct gol_hashlife* gol_hashlife_create(const int width, const int height, const int step_log2,
+                                         const size_t memory_limit, const uint16_t born, const uint16_t survive);
+// Frees the universe and all of its nodes.
+void gol_hashlife_destroy(struct gol_hashlife* hl);
+// Replaces the universe with the window's cells, in the bit-packed row layout
+// of gol.c: 64 cells per word, stride words from the start of one row to the
+// next.
+void gol_hashlife_load(struct gol_hashlife* hl, const uint64_t* plane, const int stride);
+void gol_hashlife_step(struct gol_hashlife* hl);
+// Writes the window's cells into a plane of the same layout.
+void gol_hashlife_store(struct gol_hashlife* hl, uint64_t* plane, const int stride);
+#endif // GOL_HASHLIFE_H_
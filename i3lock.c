@@ -21,12 +21,14 @@
 #include <err.h>
 #include <errno.h>
 #include <assert.h>
+#include <signal.h>
 #ifdef __OpenBSD__
 #include <bsd_auth.h>
 #else
 #include <security/pam_appl.h>
 #endif
 #include <getopt.h>
+#include <pthread.h>
 #include <ev.h>
 #include <sys/mman.h>
 #include <xkbcommon/xkbcommon.h>
@@ -46,6 +48,10 @@
 #include "unlock_indicator.h"
 #include "randr.h"
 #include "dpi.h"
+#include "gol.h"
+#include "frame_stats.h"
+#include "present.h"
+#include "dpms.h"
 
 #define TSTAMP_N_SECS(n) (n * 1.0)
 #define TSTAMP_N_MINS(n) (60 * TSTAMP_N_SECS(n))
@@ -56,6 +62,8 @@
 
 typedef void (*ev_callback_t)(EV_P_ ev_timer *w, int revents);
 static void input_done(void);
+static void handle_keysym(xkb_keysym_t ksym, bool ctrl);
+static void dump_frame_stats(void);
 
 char color[7] = "a3a3a3";
 uint32_t last_resolution[2];
@@ -77,6 +85,23 @@ struct ev_loop *main_loop;
 static struct ev_timer *clear_auth_wrong_timeout;
 static struct ev_timer *clear_indicator_timeout;
 static struct ev_timer *discard_passwd_timeout;
+/* Authentication in progress, see input_done(). */
+static pthread_t auth_thread;
+static ev_async auth_done_watcher;
+static bool auth_succeeded;
+/* Key presses received while the password is being verified. They are
+ * handled once the result is known, as if the main loop had been blocked,
+ * decoded with the modifiers and layout of when they were typed. */
+struct queued_key {
+    xkb_keysym_t ksym;
+    bool ctrl;
+};
+static struct queued_key *queued_keys = NULL;
+static int queued_keys_len = 0;
+static int queued_keys_size = 0;
+/* Set when the queue could not grow: the keys typed since are discarded
+ * with the password, rather than replayed with some missing. */
+static bool queued_keys_lost = false;
 extern unlock_state_t unlock_state;
 extern auth_state_t auth_state;
 int failed_attempts = 0;
@@ -92,9 +117,23 @@ static struct xkb_compose_state *xkb_compose_state;
 static uint8_t xkb_base_event;
 static uint8_t xkb_base_error;
 static int randr_base = -1;
+/* Frames (and generations) of the game of life per second. */
+static int gol_fps = 5;
+/* Whether the generations missed while the animation was paused are
+ * computed when it resumes. */
+static bool gol_fast_forward = false;
+/* The animation pauses while nobody can see it. */
+static bool screen_off = false;
+static bool window_obscured = false;
+static bool animation_paused = false;
+static double paused_at;
+static ev_timer animation_timer;
+/* Polls DPMS on servers that send no DPMS events. */
+static ev_timer dpms_timer;
 
 cairo_surface_t *img = NULL;
 bool tile = false;
+bool render_cairo = false;
 bool ignore_empty_password = false;
 bool skip_repeated_empty_password = false;
 xcb_pixmap_t bg_pixmap;
@@ -198,6 +237,35 @@ static void clear_password_memory(void) {
 #endif
 }
 
+/*
+ * Clears the memory of queued key presses, like clear_password_memory().
+ *
+ */
+static void clear_key_memory(struct queued_key *keys, int n) {
+    if (n == 0) {
+        return;
+    }
+#ifdef HAVE_EXPLICIT_BZERO
+    explicit_bzero(keys, n * sizeof(struct queued_key));
+#else
+    volatile struct queued_key *vkeys = keys;
+    for (int i = 0; i < n; i++) {
+        vkeys[i].ksym = i + (int)beep;
+        vkeys[i].ctrl = false;
+    }
+#endif
+}
+
+/*
+ * Forgets the queued key presses.
+ *
+ */
+static void clear_queued_keys(void) {
+    clear_key_memory(queued_keys, queued_keys_len);
+    queued_keys_len = 0;
+    queued_keys_lost = false;
+}
+
 ev_timer *start_timer(ev_timer *timer_obj, ev_tstamp timeout, ev_callback_t callback) {
     if (timer_obj) {
         ev_timer_stop(main_loop, timer_obj);
@@ -276,42 +344,122 @@ static void discard_passwd_cb(EV_P_ ev_timer *w, int revents) {
     STOP_TIMER(discard_passwd_timeout);
 }
 
+/*
+ * Runs the authentication on its own thread, so that the main loop keeps
+ * animating and redrawing while PAM (or bsd_auth) takes its time, e.g. with
+ * pam_faildelay or network backends. The main loop is woken up through
+ * auth_done_watcher once the result is known.
+ *
+ */
+static void *auth_thread_main(void *arg) {
+#ifdef __OpenBSD__
+    struct passwd *pw;
+
+    if (!(pw = getpwuid(getuid()))) {
+        errx(1, "unknown uid %u.", getuid());
+    }
+
+    auth_succeeded = (auth_userokay(pw->pw_name, NULL, NULL, password) == 0);
+#else
+    auth_succeeded = (pam_authenticate(pam_handle, 0) == PAM_SUCCESS);
+#endif
+
+    ev_async_send(main_loop, &auth_done_watcher);
+    return NULL;
+}
+
 static void input_done(void) {
     STOP_TIMER(clear_auth_wrong_timeout);
+    /* The password must stay untouched while it is being verified. */
+    STOP_TIMER(discard_passwd_timeout);
     auth_state = STATE_AUTH_VERIFY;
     unlock_state = STATE_STARTED;
     redraw_screen();
 
-#ifdef __OpenBSD__
-    struct passwd *pw;
-
-    if (!(pw = getpwuid(getuid()))) {
-        errx(1, "unknown uid %u.", getuid());
+    int ret;
+    if ((ret = pthread_create(&auth_thread, NULL, auth_thread_main, NULL)) != 0) {
+        errx(EXIT_FAILURE, "pthread_create: %s", strerror(ret));
     }
+}
 
-    if (auth_userokay(pw->pw_name, NULL, NULL, password) != 0) {
-        DEBUG("successfully authenticated\n");
-        clear_password_memory();
+/*
+ * Queues a key press received while the password is being verified.
+ *
+ */
+static void queue_key_press(xkb_keysym_t ksym, bool ctrl) {
+    if (queued_keys_lost) {
+        return;
+    }
+    if (queued_keys_len == queued_keys_size) {
+        const int size = (queued_keys_size == 0 ? 128 : queued_keys_size * 2);
+        struct queued_key *keys = malloc(size * sizeof(struct queued_key));
+        if (keys == NULL) {
+            queued_keys_lost = true;
+            return;
+        }
+        /* Not realloc(), which would leave the old keys behind uncleared. */
+        if (queued_keys != NULL) {
+            memcpy(keys, queued_keys, queued_keys_len * sizeof(struct queued_key));
+            clear_key_memory(queued_keys, queued_keys_len);
+            free(queued_keys);
+        }
+        queued_keys = keys;
+        queued_keys_size = size;
+    }
+    queued_keys[queued_keys_len].ksym = ksym;
+    queued_keys[queued_keys_len].ctrl = ctrl;
+    queued_keys_len++;
+}
 
-        ev_break(EV_DEFAULT, EVBREAK_ALL);
+/*
+ * Handles the key presses queued while the password was being verified, in
+ * the order they were typed.
+ *
+ */
+static void replay_key_presses(void) {
+    if (queued_keys_lost) {
+        DEBUG("key presses lost during verification, discarding them\n");
+        clear_queued_keys();
         return;
     }
-#else
-    if (pam_authenticate(pam_handle, 0) == PAM_SUCCESS) {
+    const int queued = queued_keys_len;
+    queued_keys_len = 0;
+    for (int i = 0; i < queued; i++) {
+        /* A replayed Enter starts verifying again, the keys after it are
+         * queued anew, ahead of where they are read from. */
+        if (auth_state == STATE_AUTH_VERIFY) {
+            queue_key_press(queued_keys[i].ksym, queued_keys[i].ctrl);
+        } else {
+            handle_keysym(queued_keys[i].ksym, queued_keys[i].ctrl);
+        }
+    }
+    clear_key_memory(queued_keys + queued_keys_len, queued - queued_keys_len);
+}
+
+/*
+ * Called on the main loop once the authentication thread has a result.
+ *
+ */
+static void auth_done_cb(EV_P_ ev_async *w, int revents) {
+    pthread_join(auth_thread, NULL);
+
+    if (auth_succeeded) {
         DEBUG("successfully authenticated\n");
         clear_password_memory();
+        clear_queued_keys();
 
+#ifndef __OpenBSD__
         /* PAM credentials should be refreshed, this will for example update any kerberos tickets.
          * Related to credentials pam_end() needs to be called to cleanup any temporary
          * credentials like kerberos /tmp/krb5cc_pam_* files which may of been left behind if the
          * refresh of the credentials failed. */
         pam_setcred(pam_handle, PAM_REFRESH_CRED);
         pam_cleanup = true;
+#endif
 
         ev_break(EV_DEFAULT, EVBREAK_ALL);
         return;
     }
-#endif
 
     if (debug_mode) {
         fprintf(stderr, "Authentication failure\n");
@@ -338,6 +486,8 @@ static void input_done(void) {
         xcb_bell(conn, 100);
         xcb_flush(conn);
     }
+
+    replay_key_presses();
 }
 
 static void redraw_timeout(EV_P_ ev_timer *w, int revents) {
@@ -358,21 +508,32 @@ static bool skip_without_validation(void) {
 }
 
 /*
- * Handle key presses. Fixes state, then looks up the key symbol for the
- * given keycode, then looks up the key symbol (as UCS-2), converts it to
- * UTF-8 and stores it in the password array.
+ * Handle key presses. Looks up the key symbol for the given keycode with the
+ * current keyboard state, then handles it, or queues it while the password
+ * is being verified.
  *
  */
 static void handle_key_press(xcb_key_press_event_t *event) {
-    xkb_keysym_t ksym;
+    const xkb_keysym_t ksym = xkb_state_key_get_one_sym(xkb_state, event->detail);
+    const bool ctrl = xkb_state_mod_name_is_active(xkb_state, XKB_MOD_NAME_CTRL, XKB_STATE_MODS_DEPRESSED);
+
+    if (auth_state == STATE_AUTH_VERIFY) {
+        queue_key_press(ksym, ctrl);
+        return;
+    }
+    handle_keysym(ksym, ctrl);
+}
+
+/*
+ * Handles a key symbol: converts it to UTF-8 (through the compose state)
+ * and stores it in the password array, or acts on it.
+ *
+ */
+static void handle_keysym(xkb_keysym_t ksym, bool ctrl) {
     char buffer[128];
     int n;
-    bool ctrl;
     bool composed = false;
 
-    ksym = xkb_state_key_get_one_sym(xkb_state, event->detail);
-    ctrl = xkb_state_mod_name_is_active(xkb_state, XKB_MOD_NAME_CTRL, XKB_STATE_MODS_DEPRESSED);
-
     /* The buffer will be null-terminated, so n >= 2 for 1 actual character. */
     memset(buffer, '\0', sizeof(buffer));
 
@@ -615,6 +776,7 @@ static void handle_screen_resize(void) {
 
     free(geom);
 
+    free_bg_pixmap();
     redraw_screen();
 
     uint32_t mask = XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT;
@@ -873,6 +1035,58 @@ static void maybe_close_sleep_lock_fd(void) {
     }
 }
 
+/*
+ * Catches up with the generations missed while the animation was paused,
+ * giving up after GOL_FAST_FORWARD_BUDGET seconds so that resuming stays
+ * instant.
+ *
+ */
+#define GOL_FAST_FORWARD_BUDGET 0.1
+static void fast_forward(double seconds) {
+    const unsigned long frames = seconds * gol_fps;
+    const double deadline = frame_stats_now() + GOL_FAST_FORWARD_BUDGET;
+    unsigned long done = 0;
+    while (done < frames && frame_stats_now() < deadline) {
+        gol_update();
+        done++;
+    }
+    DEBUG("fast-forwarded %lu of %lu frames\n", done, frames);
+}
+
+/*
+ * Pauses the animation while nobody can see it: when DPMS powered the
+ * screens down, or when the window is fully obscured, which includes the X
+ * screen saver blanking the screen. Resuming draws a frame right away.
+ *
+ */
+static void update_animation(void) {
+    const bool paused = (screen_off || window_obscured);
+    if (paused == animation_paused) {
+        return;
+    }
+    animation_paused = paused;
+
+    if (paused) {
+        DEBUG("pausing the animation (screen off: %d, obscured: %d)\n", screen_off, window_obscured);
+        paused_at = frame_stats_now();
+        if (!present_active()) {
+            ev_timer_stop(main_loop, &animation_timer);
+        }
+        return;
+    }
+
+    const double paused_for = frame_stats_now() - paused_at;
+    DEBUG("resuming the animation after %.1f s\n", paused_for);
+    if (gol_fast_forward) {
+        fast_forward(paused_for);
+    }
+    frame_stats_resume();
+    animate_screen();
+    if (!present_active()) {
+        ev_timer_again(main_loop, &animation_timer);
+    }
+}
+
 /*
  * Instead of polling the X connection socket we leave this to
  * xcb_poll_for_event() which knows better than we can ever know.
@@ -906,6 +1120,8 @@ static void xcb_check_cb(EV_P_ ev_check *w, int revents) {
 
             case XCB_VISIBILITY_NOTIFY:
                 handle_visibility_notify(conn, (xcb_visibility_notify_event_t *)event);
+                window_obscured = (((xcb_visibility_notify_event_t *)event)->state == XCB_VISIBILITY_FULLY_OBSCURED);
+                update_animation();
                 break;
 
             case XCB_MAP_NOTIFY:
@@ -921,6 +1137,10 @@ static void xcb_check_cb(EV_P_ ev_check *w, int revents) {
                     }
 
                     ev_loop_fork(EV_DEFAULT);
+                    /* Only the child has frames to report on. */
+                    if (debug_mode) {
+                        atexit(dump_frame_stats);
+                    }
                 }
                 break;
 
@@ -928,6 +1148,17 @@ static void xcb_check_cb(EV_P_ ev_check *w, int revents) {
                 handle_screen_resize();
                 break;
 
+            case XCB_GE_GENERIC:
+                if (present_handle_event(event)) {
+                    /* While paused, the chain of frames ends here. */
+                    if (!animation_paused) {
+                        animate_screen();
+                    }
+                } else if (dpms_handle_event(event, &screen_off)) {
+                    update_animation();
+                }
+                break;
+
             default:
                 if (type == xkb_base_event) {
                     process_xkb_event(event);
@@ -1002,9 +1233,38 @@ static void raise_loop(xcb_window_t window) {
     }
 }
 
+/*
+ * Animates the screen off a timer, when the Present extension is not there
+ * to pace frames to the vertical blank.
+ *
+ */
 static void timeout_cb (EV_P_ ev_timer *w, int revents) {
-    draw_image(bg_pixmap, last_resolution, true);
-    redraw_screen();
+    animate_screen();
+}
+
+/*
+ * Checks whether DPMS powered the screens up or down, for servers that do
+ * not tell.
+ *
+ */
+static void dpms_poll_cb(EV_P_ ev_timer *w, int revents) {
+    screen_off = dpms_screen_off();
+    update_animation();
+}
+
+/*
+ * Prints the frame timing histograms. SIGUSR1 is always caught, since its
+ * default action would kill i3lock and unlock the screen.
+ *
+ */
+static void dump_frame_stats_cb(EV_P_ ev_signal *w, int revents) {
+    if (debug_mode) {
+        frame_stats_dump(stderr);
+    }
+}
+
+static void dump_frame_stats(void) {
+    frame_stats_dump(stderr);
 }
 
 int main(int argc, char *argv[]) {
@@ -1036,6 +1296,17 @@ int main(int argc, char *argv[]) {
         {"inactivity-timeout", required_argument, NULL, 'I'},
         {"show-failed-attempts", no_argument, NULL, 'f'},
         {"show-keyboard-layout", no_argument, NULL, 'k'},
+        {"gol-threads", required_argument, NULL, 0},
+        {"gol-cell-size", required_argument, NULL, 0},
+        {"gol-grid", required_argument, NULL, 0},
+        {"gol-render", required_argument, NULL, 0},
+        {"gol-hashlife", required_argument, NULL, 0},
+        {"gol-hashlife-memory", required_argument, NULL, 0},
+        {"gol-fps", required_argument, NULL, 0},
+        {"gol-fast-forward", no_argument, NULL, 0},
+        {"gol-stagnation", required_argument, NULL, 0},
+        {"gol-rule", required_argument, NULL, 0},
+        {"gol-kernel", required_argument, NULL, 0},
         {NULL, no_argument, NULL, 0}};
 
     int code = EXIT_FAILURE;
@@ -1097,6 +1368,68 @@ int main(int argc, char *argv[]) {
                     debug_mode = true;
                 } else if (strcmp(longopts[longoptind].name, "raw") == 0) {
                     image_raw_format = strdup(optarg);
+                } else if (strcmp(longopts[longoptind].name, "gol-threads") == 0) {
+                    int threads;
+                    if (sscanf(optarg, "%d", &threads) != 1 || threads < 0) {
+                        errx(EXIT_FAILURE, "gol-threads is invalid, it must be a number of threads (0 for one per CPU)");
+                    }
+                    gol_set_threads(threads);
+                } else if (strcmp(longopts[longoptind].name, "gol-cell-size") == 0) {
+                    int size;
+                    if (sscanf(optarg, "%d", &size) != 1 || size < 1) {
+                        errx(EXIT_FAILURE, "gol-cell-size is invalid, it must be a positive number of pixels");
+                    }
+                    gol_set_cell_size(size);
+                } else if (strcmp(longopts[longoptind].name, "gol-grid") == 0) {
+                    int cols, rows;
+                    if (sscanf(optarg, "%dx%d", &cols, &rows) != 2 || cols < 1 || rows < 1) {
+                        errx(EXIT_FAILURE, "gol-grid is invalid, it must be given as colsxrows, e.g. 192x108");
+                    }
+                    gol_set_grid(cols, rows);
+                } else if (strcmp(longopts[longoptind].name, "gol-render") == 0) {
+                    if (!strcmp(optarg, "pixbuf")) {
+                        render_cairo = false;
+                    } else if (!strcmp(optarg, "cairo")) {
+                        render_cairo = true;
+                    } else {
+                        errx(EXIT_FAILURE, "i3lock: Invalid renderer given. Expected one of \"pixbuf\" or \"cairo\".");
+                    }
+                } else if (strcmp(longopts[longoptind].name, "gol-hashlife") == 0) {
+                    int step_log2;
+                    if (sscanf(optarg, "%d", &step_log2) != 1 || step_log2 < 0 || step_log2 > 16) {
+                        errx(EXIT_FAILURE, "gol-hashlife is invalid, it must be the log2 of the generations per step, 0 to 16");
+                    }
+                    gol_set_hashlife(step_log2);
+                } else if (strcmp(longopts[longoptind].name, "gol-hashlife-memory") == 0) {
+                    int mib;
+                    if (sscanf(optarg, "%d", &mib) != 1 || mib < 1) {
+                        errx(EXIT_FAILURE, "gol-hashlife-memory is invalid, it must be a number of MiB");
+                    }
+                    gol_set_hashlife_memory((size_t)mib << 20);
+                } else if (strcmp(longopts[longoptind].name, "gol-fps") == 0) {
+                    if (sscanf(optarg, "%d", &gol_fps) != 1 || gol_fps < 5 || gol_fps > 1000) {
+                        errx(EXIT_FAILURE, "gol-fps is invalid, it must be a number of frames per second, at least 5");
+                    }
+                } else if (strcmp(longopts[longoptind].name, "gol-fast-forward") == 0) {
+                    gol_fast_forward = true;
+                } else if (strcmp(longopts[longoptind].name, "gol-stagnation") == 0) {
+                    if (!strcmp(optarg, "replay")) {
+                        gol_set_stagnation(GOL_STAGNATION_REPLAY);
+                    } else if (!strcmp(optarg, "reseed")) {
+                        gol_set_stagnation(GOL_STAGNATION_RESEED);
+                    } else if (!strcmp(optarg, "off")) {
+                        gol_set_stagnation(GOL_STAGNATION_OFF);
+                    } else {
+                        errx(EXIT_FAILURE, "gol-stagnation is invalid, it must be one of \"replay\", \"reseed\" or \"off\"");
+                    }
+                } else if (strcmp(longopts[longoptind].name, "gol-rule") == 0) {
+                    if (!gol_set_rule(optarg)) {
+                        errx(EXIT_FAILURE, "gol-rule is invalid, it must be given as B/S digits without B0, e.g. B36/S23");
+                    }
+                } else if (strcmp(longopts[longoptind].name, "gol-kernel") == 0) {
+                    if (!gol_set_kernel(optarg)) {
+                        errx(EXIT_FAILURE, "gol-kernel is invalid, it must be a kernel this CPU can run, e.g. \"scalar\" or \"lut\"");
+                    }
                 }
                 break;
             case 'f':
@@ -1249,7 +1582,7 @@ int main(int argc, char *argv[]) {
 
     /* Pixmap on which the image is rendered to (if any) */
     bg_pixmap = create_bg_pixmap(conn, screen, last_resolution, color);
-    draw_image(bg_pixmap, last_resolution, false);
+    draw_image(bg_pixmap, last_resolution);
 
     xcb_window_t stolen_focus = find_focused_window(conn, screen->root);
 
@@ -1320,13 +1653,34 @@ int main(int argc, char *argv[]) {
     ev_prepare_init(xcb_prepare, xcb_prepare_cb);
     ev_prepare_start(main_loop, xcb_prepare);
 
-    ev_timer timer_watcher;
+    ev_async_init(&auth_done_watcher, auth_done_cb);
+    ev_async_start(main_loop, &auth_done_watcher);
+
+    ev_signal frame_stats_watcher;
+    ev_signal_init(&frame_stats_watcher, dump_frame_stats_cb, SIGUSR1);
+    ev_signal_start(main_loop, &frame_stats_watcher);
+    /* When i3lock forks, this is left to the child, see XCB_MAP_NOTIFY. */
+    if (debug_mode && dont_fork) {
+        atexit(dump_frame_stats);
+    }
 
-    // Initialize the timer watcher with a callback function, an initial delay of 1 second, and a repeat interval of 1 second.
-    ev_timer_init(&timer_watcher, timeout_cb, 1.0f/5.0f, 1.0f/5.0f);
+    if (present_init(win, gol_fps)) {
+        /* Every frame completing schedules the next one. */
+        animate_screen();
+    } else {
+        ev_timer_init(&animation_timer, timeout_cb, 1.0 / gol_fps, 1.0 / gol_fps);
+        frame_stats_set_period(1.0 / gol_fps);
+        ev_timer_start(main_loop, &animation_timer);
+    }
 
-    // Start the timer
-    ev_timer_start(main_loop, &timer_watcher);
+    if (dpms_init()) {
+        if (!dpms_has_events()) {
+            ev_timer_init(&dpms_timer, dpms_poll_cb, 1.0, 1.0);
+            ev_timer_start(main_loop, &dpms_timer);
+        }
+        screen_off = dpms_screen_off();
+        update_animation();
+    }
 
     /* Invoke the event callback once to catch all the events which were
      * received up until now. ev will only pick up new events (when the X11
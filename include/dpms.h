@@ -0,0 +1,34 @@
+#ifndef _DPMS_H
+#define _DPMS_H
+
+#include <stdbool.h>
+#include <xcb/xcb.h>
+
+/**
+ * Looks for the DPMS extension, and asks for its InfoNotify events when the
+ * server has them (DPMS 1.2). Returns false when there is no DPMS at all.
+ *
+ */
+bool dpms_init(void);
+
+/**
+ * Whether the server sends InfoNotify events. Without them, changes of the
+ * power level have to be polled for with dpms_screen_off().
+ *
+ */
+bool dpms_has_events(void);
+
+/**
+ * Asks the server whether DPMS has the screens in standby, suspend or off.
+ *
+ */
+bool dpms_screen_off(void);
+
+/**
+ * Returns true when the event is a DPMS InfoNotify, and sets *off to
+ * whether the screens are now off.
+ *
+ */
+bool dpms_handle_event(xcb_generic_event_t *event, bool *off);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include <stdbool.h>
+#include <cairo.h>
+
+#include "indicator.h"
+#include "render.h"
+
+struct frame_rect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+/* What a frame shows. */
+struct frame_scene {
+    /* The games of life, one per screen. */
+    const struct render_grid *life;
+    int nlife;
+    /* The image (-i) drawn over the cells, if any, and whether it is tiled. */
+    cairo_surface_t *img;
+    bool tile;
+    double scaling_factor;
+    /* The unlock indicator, or NULL when it is hidden. */
+    const struct indicator_state *indicator;
+    /* The indicator is shown in the middle of each of these. */
+    const struct frame_rect *screens;
+    int nscreens;
+};
+
+/* A cairo surface frames are drawn onto. It keeps its contents between
+ * frame_draw() calls, so only what changed since is drawn again. */
+struct frame {
+    int width;
+    int height;
+    cairo_surface_t *surface;
+    cairo_t *ctx;
+    /* The pixels of the surface when it is an image surface over a
+     * client-side buffer, which the cells are rasterized into directly.
+     * pixels is NULL when only cairo can draw on the surface. */
+    struct render_buffer buffer;
+    /* In-memory surface the unlock indicator is rendered on. */
+    cairo_surface_t *indicator_surface;
+    cairo_t *indicator_ctx;
+    int indicator_diameter;
+    /* What the surface holds. */
+    bool drawn;
+    /* Generation of each game of the scene, in the order of its life. */
+    unsigned long *generations;
+    int ngenerations;
+    bool indicator;
+    /* Regions changed by the last frame_draw() call. */
+    struct frame_rect *damage;
+    int damage_len;
+    int damage_size;
+};
+
+/**
+ * Sets up a frame drawn with cairo onto the given surface, of any type.
+ *
+ */
+void frame_init(struct frame *frame, cairo_surface_t *surface, int width, int height);
+
+/**
+ * Sets up a frame over a buffer of 0x00RRGGBB pixels, which is not freed by
+ * frame_free().
+ *
+ */
+void frame_init_buffer(struct frame *frame, const struct render_buffer *buffer);
+
+/**
+ * Frees what frame_init() or frame_init_buffer() allocated.
+ *
+ */
+void frame_free(struct frame *frame);
+
+/**
+ * Draws the scene onto the frame and records the regions that changed in
+ * its damage. Only the cells that changed are repainted when the simulation
+ * advanced by one step since the last call.
+ *
+ */
+void frame_draw(struct frame *frame, const struct frame_scene *scene);
+
+#endif
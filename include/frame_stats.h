@@ -0,0 +1,65 @@
+#ifndef _FRAME_STATS_H
+#define _FRAME_STATS_H
+
+#include <stdio.h>
+
+/* The stages of a frame, timed separately. */
+enum frame_stage {
+    FRAME_STAGE_SIMULATE,  /* gol_update(), but for what detect took */
+    FRAME_STAGE_DETECT,    /* hashing generations and looking for cycles */
+    FRAME_STAGE_RASTERIZE, /* painting the cells and the image */
+    FRAME_STAGE_INDICATOR, /* drawing and compositing the unlock indicator */
+    FRAME_STAGE_PRESENT,   /* uploading the damage and flushing it to X11 */
+    FRAME_STAGE_COUNT,
+};
+
+/**
+ * Returns the time of the monotonic clock, in seconds.
+ *
+ */
+double frame_stats_now(void);
+
+/**
+ * Sets the period of the animation timer, against which frames are counted
+ * as late or dropped.
+ *
+ */
+void frame_stats_set_period(double period);
+
+/**
+ * Adds the time one stage of a frame took to its histogram.
+ *
+ */
+void frame_stats_record(enum frame_stage stage, double seconds);
+
+/**
+ * Accounts for an animation frame that started and ended at the given
+ * times: it is late when it took longer than the timer period, and the
+ * timer periods that passed since the previous frame without one are
+ * dropped.
+ *
+ */
+void frame_stats_frame(double start, double end);
+
+/**
+ * Counts a frame drawn onto the background pixmap, and one sent to the X
+ * server.
+ *
+ */
+void frame_stats_rendered(void);
+void frame_stats_presented(void);
+
+/**
+ * Forgets when the last animation frame started, so that the time the
+ * animation was paused is not counted as dropped frames.
+ *
+ */
+void frame_stats_resume(void);
+
+/**
+ * Prints p50/p95/p99/max of every stage, and the late and dropped frames.
+ *
+ */
+void frame_stats_dump(FILE *out);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _INDICATOR_H
+#define _INDICATOR_H
+
+#include <stdbool.h>
+#include <cairo.h>
+
+typedef enum {
+    STATE_STARTED = 0,           /* default state */
+    STATE_KEY_PRESSED = 1,       /* key was pressed, show unlock indicator */
+    STATE_KEY_ACTIVE = 2,        /* a key was pressed recently, highlight part
+                                   of the unlock indicator. */
+    STATE_BACKSPACE_ACTIVE = 3,  /* backspace was pressed recently, highlight
+                                   part of the unlock indicator in red. */
+    STATE_NOTHING_TO_DELETE = 4, /* backspace was pressed, but there is nothing to delete. */
+} unlock_state_t;
+
+typedef enum {
+    STATE_AUTH_IDLE = 0,          /* no authenticator interaction at the moment */
+    STATE_AUTH_VERIFY = 1,        /* currently verifying the password via authenticator */
+    STATE_AUTH_LOCK = 2,          /* currently locking the screen */
+    STATE_AUTH_WRONG = 3,         /* the password was wrong */
+    STATE_I3LOCK_LOCK_FAILED = 4, /* i3lock failed to load */
+} auth_state_t;
+
+/* Everything the unlock indicator shows. */
+struct indicator_state {
+    unlock_state_t unlock_state;
+    auth_state_t auth_state;
+    /* Failed unlock attempts to show, 0 for none. */
+    int failed_attempts;
+    /* Active modifiers and keyboard layout to show, or NULL. */
+    const char *modifier_string;
+    const char *layout_string;
+};
+
+/**
+ * Returns the size in pixels of the unlock indicator at the given scaling
+ * factor.
+ *
+ */
+int indicator_diameter(double scaling_factor);
+
+/**
+ * Draws the unlock indicator onto a transparent surface of
+ * indicator_diameter() pixels, replacing whatever it held.
+ *
+ */
+void draw_indicator(cairo_t *ctx, double scaling_factor, const struct indicator_state *state);
+
+#endif
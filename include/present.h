@@ -0,0 +1,37 @@
+#ifndef _PRESENT_H
+#define _PRESENT_H
+
+#include <stdbool.h>
+#include <xcb/xcb.h>
+
+/**
+ * Sets up showing frames on the given window through the Present extension,
+ * at most fps of them per second and never more than one per vertical
+ * blank. Returns false when the X server lacks Present or XFixes, in which
+ * case frames have to be paced some other way.
+ *
+ */
+bool present_init(xcb_window_t window, int fps);
+
+/**
+ * Whether present_init() succeeded.
+ *
+ */
+bool present_active(void);
+
+/**
+ * Shows the given rectangles of the pixmap on the window at the next
+ * vertical blank that is due, or merely waits for it when there are none.
+ * Either way, a CompleteNotify follows.
+ *
+ */
+void present_schedule(xcb_pixmap_t pixmap, const xcb_rectangle_t *rects, int nrects);
+
+/**
+ * Returns true when the event is the CompleteNotify for the last
+ * present_schedule() call, which means the next frame is due.
+ *
+ */
+bool present_handle_event(xcb_generic_event_t *event);
+
+#endif
@@ -6,6 +6,9 @@ typedef struct Rect {
     int16_t y;
     uint16_t width;
     uint16_t height;
+    /* Physical size, 0 when unknown (Xinerama) or not reported. */
+    uint32_t mm_width;
+    uint32_t mm_height;
 } Rect;
 
 extern int xr_screens;
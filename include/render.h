@@ -0,0 +1,80 @@
+#ifndef _RENDER_H
+#define _RENDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A client-side frame buffer of 32 bit 0x00RRGGBB pixels. */
+struct render_buffer {
+    uint32_t *pixels;
+    int width;
+    int height;
+    /* Distance between the start of two rows, in pixels. */
+    int stride;
+};
+
+/* How the game of life grid of one screen maps onto the frame. */
+struct render_grid {
+    /* The game shown, see gol_select(). */
+    int screen;
+    /* The rectangle of the frame it is shown in, the cells start at its top
+     * left corner. */
+    int x;
+    int y;
+    int width;
+    int height;
+    int cols;
+    int rows;
+    /* Size of a cell in pixels. */
+    int size;
+    uint32_t background;
+    uint32_t foreground;
+};
+
+/**
+ * Returns the stride, in pixels, of a frame buffer of the given width.
+ *
+ */
+int render_buffer_stride(int width);
+
+/**
+ * Allocates a frame buffer of the given size. Returns false if there is not
+ * enough memory.
+ *
+ */
+bool render_buffer_init(struct render_buffer *buf, int width, int height);
+
+/**
+ * Sets up a frame buffer over memory allocated elsewhere, which is not freed
+ * by render_buffer_free().
+ *
+ */
+void render_buffer_wrap(struct render_buffer *buf, uint32_t *pixels, int width, int height, int stride);
+
+/**
+ * Frees the pixels of a frame buffer allocated by render_buffer_init().
+ *
+ */
+void render_buffer_free(struct render_buffer *buf);
+
+/**
+ * Fills the given rectangle, clipped to the frame buffer, with one pixel
+ * value.
+ *
+ */
+void render_fill_rect(struct render_buffer *buf, int x, int y, int width, int height, uint32_t pixel);
+
+/**
+ * Rasterizes the background and the live cells of the grid within the given
+ * rectangle, clipped to the grid's own.
+ *
+ */
+void render_life(struct render_buffer *buf, const struct render_grid *grid, int x, int y, int width, int height);
+
+/**
+ * Rasterizes only the cells that changed in the last generation.
+ *
+ */
+void render_changed_cells(struct render_buffer *buf, const struct render_grid *grid);
+
+#endif
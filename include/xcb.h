@@ -2,12 +2,26 @@
 #define _XCB_H
 
 #include <xcb/xcb.h>
+#include <xcb/shm.h>
 
 extern xcb_connection_t *conn;
 extern xcb_screen_t *screen;
 
+/* A shared memory segment attached to the X server. */
+struct shm_segment {
+    xcb_shm_seg_t seg;
+    void *addr;
+};
+
 xcb_visualtype_t *get_root_visual_type(xcb_screen_t *s);
 xcb_pixmap_t create_bg_pixmap(xcb_connection_t *conn, xcb_screen_t *scr, u_int32_t *resolution, char *color);
+bool visual_is_rgb24(xcb_connection_t *conn, xcb_screen_t *scr);
+void put_pixels(xcb_connection_t *conn, xcb_drawable_t drawable, xcb_gcontext_t gc, uint8_t depth,
+                const uint32_t *pixels, int stride, xcb_rectangle_t rect);
+bool shm_segment_create(xcb_connection_t *conn, size_t size, struct shm_segment *segment);
+void shm_segment_destroy(xcb_connection_t *conn, struct shm_segment *segment);
+void shm_put_pixels(xcb_connection_t *conn, xcb_drawable_t drawable, xcb_gcontext_t gc, uint8_t depth,
+                    struct shm_segment *segment, int stride, int height, xcb_rectangle_t rect);
 xcb_window_t open_fullscreen_window(xcb_connection_t *conn, xcb_screen_t *scr, char *color, xcb_pixmap_t pixmap);
 bool grab_pointer_and_keyboard(xcb_connection_t *conn, xcb_screen_t *screen, xcb_cursor_t cursor, int tries);
 xcb_cursor_t create_cursor(xcb_connection_t *conn, xcb_screen_t *screen, xcb_window_t win, int choice);
@@ -0,0 +1,215 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * © 2010 Michael Stapelberg
+ *
+ * See LICENSE for licensing information
+ *
+ * indicator.c: draws the unlock indicator, without any knowledge of X11.
+ *
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <cairo.h>
+
+#include "indicator.h"
+
+#define BUTTON_RADIUS 90
+#define BUTTON_SPACE (BUTTON_RADIUS + 5)
+#define BUTTON_CENTER (BUTTON_RADIUS + 5)
+#define BUTTON_DIAMETER (2 * BUTTON_SPACE)
+
+static void display_button_text(
+    cairo_t *ctx, const char *text, double y_offset, bool use_dark_text) {
+    cairo_text_extents_t extents;
+    double x, y;
+
+    cairo_text_extents(ctx, text, &extents);
+    x = BUTTON_CENTER - ((extents.width / 2) + extents.x_bearing);
+    y = BUTTON_CENTER - ((extents.height / 2) + extents.y_bearing) + y_offset;
+
+    cairo_move_to(ctx, x, y);
+    if (use_dark_text) {
+        cairo_set_source_rgb(ctx, 0., 0., 0.);
+    } else {
+        cairo_set_source_rgb(ctx, 1., 1., 1.);
+    }
+    cairo_show_text(ctx, text);
+    cairo_close_path(ctx);
+}
+
+int indicator_diameter(double scaling_factor) {
+    return ceil(scaling_factor * BUTTON_DIAMETER);
+}
+
+void draw_indicator(cairo_t *ctx, double scaling_factor, const struct indicator_state *state) {
+    /* The surface still holds the last indicator drawn. */
+    cairo_save(ctx);
+    cairo_set_operator(ctx, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(ctx);
+    cairo_restore(ctx);
+
+    cairo_save(ctx);
+    cairo_scale(ctx, scaling_factor, scaling_factor);
+    /* Draw a (centered) circle with transparent background. */
+    cairo_set_line_width(ctx, 10.0);
+    cairo_arc(ctx,
+              BUTTON_CENTER /* x */,
+              BUTTON_CENTER /* y */,
+              BUTTON_RADIUS /* radius */,
+              0 /* start */,
+              2 * M_PI /* end */);
+
+    /* Use the appropriate color for the different PAM states
+     * (currently verifying, wrong password, or default) */
+    switch (state->auth_state) {
+        case STATE_AUTH_VERIFY:
+        case STATE_AUTH_LOCK:
+            cairo_set_source_rgba(ctx, 0, 114.0 / 255, 255.0 / 255, 0.75);
+            break;
+        case STATE_AUTH_WRONG:
+        case STATE_I3LOCK_LOCK_FAILED:
+            cairo_set_source_rgba(ctx, 250.0 / 255, 0, 0, 0.75);
+            break;
+        default:
+            if (state->unlock_state == STATE_NOTHING_TO_DELETE) {
+                cairo_set_source_rgba(ctx, 250.0 / 255, 0, 0, 0.75);
+                break;
+            }
+            cairo_set_source_rgba(ctx, 0, 0, 0, 0.75);
+            break;
+    }
+    cairo_fill_preserve(ctx);
+
+    bool use_dark_text = true;
+
+    switch (state->auth_state) {
+        case STATE_AUTH_VERIFY:
+        case STATE_AUTH_LOCK:
+            cairo_set_source_rgb(ctx, 51.0 / 255, 0, 250.0 / 255);
+            break;
+        case STATE_AUTH_WRONG:
+        case STATE_I3LOCK_LOCK_FAILED:
+            cairo_set_source_rgb(ctx, 125.0 / 255, 51.0 / 255, 0);
+            break;
+        case STATE_AUTH_IDLE:
+            if (state->unlock_state == STATE_NOTHING_TO_DELETE) {
+                cairo_set_source_rgb(ctx, 125.0 / 255, 51.0 / 255, 0);
+                break;
+            }
+
+            cairo_set_source_rgb(ctx, 51.0 / 255, 125.0 / 255, 0);
+            use_dark_text = false;
+            break;
+    }
+    cairo_stroke(ctx);
+
+    /* Draw an inner seperator line. */
+    cairo_set_source_rgb(ctx, 0, 0, 0);
+    cairo_set_line_width(ctx, 2.0);
+    cairo_arc(ctx,
+              BUTTON_CENTER /* x */,
+              BUTTON_CENTER /* y */,
+              BUTTON_RADIUS - 5 /* radius */,
+              0,
+              2 * M_PI);
+    cairo_stroke(ctx);
+
+    cairo_set_line_width(ctx, 10.0);
+
+    /* Display a (centered) text of the current PAM state. */
+    char *text = NULL;
+    /* We don't want to show more than a 3-digit number. */
+    char buf[4];
+
+    cairo_set_source_rgb(ctx, 0, 0, 0);
+    cairo_select_font_face(ctx, "sans-serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(ctx, 28.0);
+    switch (state->auth_state) {
+        case STATE_AUTH_VERIFY:
+            text = "Verifying…";
+            break;
+        case STATE_AUTH_LOCK:
+            text = "Locking…";
+            break;
+        case STATE_AUTH_WRONG:
+            text = "Wrong!";
+            break;
+        case STATE_I3LOCK_LOCK_FAILED:
+            text = "Lock failed!";
+            break;
+        default:
+            if (state->unlock_state == STATE_NOTHING_TO_DELETE) {
+                text = "No input";
+            }
+            if (state->failed_attempts > 0) {
+                if (state->failed_attempts > 999) {
+                    text = "> 999";
+                } else {
+                    snprintf(buf, sizeof(buf), "%d", state->failed_attempts);
+                    text = buf;
+                }
+                cairo_set_source_rgb(ctx, 1, 0, 0);
+                cairo_set_font_size(ctx, 32.0);
+            }
+            break;
+    }
+
+    if (text) {
+        display_button_text(ctx, text, 0., use_dark_text);
+    }
+
+    if (state->modifier_string != NULL) {
+        cairo_set_font_size(ctx, 14.0);
+        display_button_text(ctx, state->modifier_string, 28., use_dark_text);
+    }
+    if (state->layout_string != NULL) {
+        cairo_set_font_size(ctx, 14.0);
+        display_button_text(ctx, state->layout_string, -28., use_dark_text);
+    }
+
+    /* After the user pressed any valid key or the backspace key, we
+     * highlight a random part of the unlock indicator to confirm this
+     * keypress. */
+    if (state->unlock_state == STATE_KEY_ACTIVE ||
+        state->unlock_state == STATE_BACKSPACE_ACTIVE) {
+        cairo_new_sub_path(ctx);
+        double highlight_start = (rand() % (int)(2 * M_PI * 100)) / 100.0;
+        cairo_arc(ctx,
+                  BUTTON_CENTER /* x */,
+                  BUTTON_CENTER /* y */,
+                  BUTTON_RADIUS /* radius */,
+                  highlight_start,
+                  highlight_start + (M_PI / 3.0));
+        if (state->unlock_state == STATE_KEY_ACTIVE) {
+            /* For normal keys, we use a lighter green. */
+            cairo_set_source_rgb(ctx, 51.0 / 255, 219.0 / 255, 0);
+        } else {
+            /* For backspace, we use red. */
+            cairo_set_source_rgb(ctx, 219.0 / 255, 51.0 / 255, 0);
+        }
+        cairo_stroke(ctx);
+
+        /* Draw two little separators for the highlighted part of the
+         * unlock indicator. */
+        cairo_set_source_rgb(ctx, 0, 0, 0);
+        cairo_arc(ctx,
+                  BUTTON_CENTER /* x */,
+                  BUTTON_CENTER /* y */,
+                  BUTTON_RADIUS /* radius */,
+                  highlight_start /* start */,
+                  highlight_start + (M_PI / 128.0) /* end */);
+        cairo_stroke(ctx);
+        cairo_arc(ctx,
+                  BUTTON_CENTER /* x */,
+                  BUTTON_CENTER /* y */,
+                  BUTTON_RADIUS /* radius */,
+                  (highlight_start + (M_PI / 3.0)) - (M_PI / 128.0) /* start */,
+                  highlight_start + (M_PI / 3.0) /* end */);
+        cairo_stroke(ctx);
+    }
+    cairo_new_path(ctx);
+    cairo_restore(ctx);
+}
@@ -0,0 +1,141 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * present.c: paces the animation to the vertical blank with the Present
+ *            extension. Each frame is scheduled for a target MSC (the
+ *            counter of vertical blanks), and its CompleteNotify is what
+ *            triggers the next one.
+ *
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <xcb/xcb.h>
+#include <xcb/present.h>
+#include <xcb/xfixes.h>
+
+#include "i3lock.h"
+#include "xcb.h"
+#include "present.h"
+#include "frame_stats.h"
+
+extern bool debug_mode;
+
+/* Assumed until two CompleteNotify events tell the real refresh period. */
+#define PRESENT_DEFAULT_REFRESH (1.0 / 60.0)
+
+static bool has_present = false;
+static uint8_t present_opcode;
+static xcb_window_t present_window;
+/* The region of the pixmap each frame updates, i.e. its damage. */
+static xcb_xfixes_region_t update_region;
+static int target_fps;
+
+/* Serial of the frame in flight, whose completion starts the next one. */
+static uint32_t serial = 0;
+/* MSC and UST (in microseconds) of the last completed frame. */
+static uint64_t last_msc = 0;
+static uint64_t last_ust = 0;
+/* Vertical blanks between frames, to get as close to target_fps as the
+ * refresh rate allows. */
+static uint64_t interval = 1;
+
+static void update_interval(double refresh) {
+    interval = (uint64_t)(1.0 / (target_fps * refresh) + 0.5);
+    if (interval < 1) {
+        interval = 1;
+    }
+    frame_stats_set_period(interval * refresh);
+}
+
+bool present_init(xcb_window_t window, int fps) {
+    const xcb_query_extension_reply_t *extreply = xcb_get_extension_data(conn, &xcb_present_id);
+    if (extreply == NULL || !extreply->present) {
+        DEBUG("Present is not available, pacing frames with a timer.\n");
+        return false;
+    }
+    const xcb_query_extension_reply_t *xfixes_reply = xcb_get_extension_data(conn, &xcb_xfixes_id);
+    if (xfixes_reply == NULL || !xfixes_reply->present) {
+        DEBUG("XFixes is not available, pacing frames with a timer.\n");
+        return false;
+    }
+
+    xcb_generic_error_t *err;
+    xcb_present_query_version_reply_t *present_version =
+        xcb_present_query_version_reply(
+            conn, xcb_present_query_version(conn, XCB_PRESENT_MAJOR_VERSION, XCB_PRESENT_MINOR_VERSION), &err);
+    if (err != NULL) {
+        DEBUG("Could not query Present version: X11 error code %d\n", err->error_code);
+        free(err);
+        return false;
+    }
+    free(present_version);
+
+    /* XFixes requests are only allowed once the version was negotiated. */
+    xcb_xfixes_query_version_reply_t *xfixes_version =
+        xcb_xfixes_query_version_reply(
+            conn, xcb_xfixes_query_version(conn, XCB_XFIXES_MAJOR_VERSION, XCB_XFIXES_MINOR_VERSION), &err);
+    if (err != NULL) {
+        DEBUG("Could not query XFixes version: X11 error code %d\n", err->error_code);
+        free(err);
+        return false;
+    }
+    free(xfixes_version);
+
+    update_region = xcb_generate_id(conn);
+    xcb_xfixes_create_region(conn, update_region, 0, NULL);
+    xcb_present_select_input(conn, xcb_generate_id(conn), window,
+                             XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+
+    present_opcode = extreply->major_opcode;
+    present_window = window;
+    target_fps = fps;
+    update_interval(PRESENT_DEFAULT_REFRESH);
+    has_present = true;
+    DEBUG("pacing frames with Present, at most %d per second\n", fps);
+    return true;
+}
+
+bool present_active(void) {
+    return has_present;
+}
+
+void present_schedule(xcb_pixmap_t pixmap, const xcb_rectangle_t *rects, int nrects) {
+    /* Before the first frame completed, the next vertical blank is due. A
+     * target that already went by also means the next one. */
+    const uint64_t target_msc = (last_msc > 0 ? last_msc + interval : 0);
+    serial++;
+    if (nrects > 0) {
+        xcb_xfixes_set_region(conn, update_region, nrects, rects);
+        /* Copy rather than flip: the pixmap is free to be drawn on again as
+         * soon as the frame completed, and keeps what was drawn on it so
+         * the next frame only has to draw what changed. */
+        xcb_present_pixmap(conn, present_window, pixmap, serial,
+                           XCB_NONE, update_region, 0, 0, XCB_NONE, XCB_NONE, XCB_NONE,
+                           XCB_PRESENT_OPTION_COPY, target_msc, 0, 0, 0, NULL);
+    } else {
+        xcb_present_notify_msc(conn, present_window, serial, target_msc, 0, 0);
+    }
+    xcb_flush(conn);
+}
+
+bool present_handle_event(xcb_generic_event_t *event) {
+    if (!has_present || (event->response_type & 0x7F) != XCB_GE_GENERIC) {
+        return false;
+    }
+    xcb_ge_generic_event_t *generic = (xcb_ge_generic_event_t *)event;
+    if (generic->extension != present_opcode || generic->event_type != XCB_PRESENT_EVENT_COMPLETE_NOTIFY) {
+        return false;
+    }
+    xcb_present_complete_notify_event_t *complete = (xcb_present_complete_notify_event_t *)event;
+    if (complete->window != present_window || complete->serial != serial) {
+        return false;
+    }
+
+    if (last_ust > 0 && complete->msc > last_msc && complete->ust > last_ust) {
+        update_interval((complete->ust - last_ust) / 1e6 / (complete->msc - last_msc));
+    }
+    last_msc = complete->msc;
+    last_ust = complete->ust;
+    return true;
+}
@@ -142,6 +142,8 @@ static bool _randr_query_monitors_15(xcb_window_t root) {
         resolutions[screen].y = monitor_info->y;
         resolutions[screen].width = monitor_info->width;
         resolutions[screen].height = monitor_info->height;
+        resolutions[screen].mm_width = monitor_info->width_in_millimeters;
+        resolutions[screen].mm_height = monitor_info->height_in_millimeters;
         DEBUG("found RandR monitor: %d x %d at %d x %d\n",
               monitor_info->width, monitor_info->height,
               monitor_info->x, monitor_info->y);
@@ -225,6 +227,14 @@ static bool _randr_query_outputs_14(xcb_window_t root) {
         resolutions[screen].y = crtc->y;
         resolutions[screen].width = crtc->width;
         resolutions[screen].height = crtc->height;
+        /* The physical size is that of the output, whatever its rotation. */
+        if (crtc->rotation & (XCB_RANDR_ROTATION_ROTATE_90 | XCB_RANDR_ROTATION_ROTATE_270)) {
+            resolutions[screen].mm_width = output->mm_height;
+            resolutions[screen].mm_height = output->mm_width;
+        } else {
+            resolutions[screen].mm_width = output->mm_width;
+            resolutions[screen].mm_height = output->mm_height;
+        }
 
         DEBUG("found RandR output: %d x %d at %d x %d\n",
               crtc->width, crtc->height,
@@ -274,6 +284,8 @@ void _xinerama_query_screens(void) {
         resolutions[screen].y = screen_info[screen].y_org;
         resolutions[screen].width = screen_info[screen].width;
         resolutions[screen].height = screen_info[screen].height;
+        resolutions[screen].mm_width = 0;
+        resolutions[screen].mm_height = 0;
         DEBUG("found Xinerama screen: %d x %d at %d x %d\n",
               screen_info[screen].width, screen_info[screen].height,
               screen_info[screen].x_org, screen_info[screen].y_org);
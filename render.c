@@ -0,0 +1,208 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * render.c: rasterizes the game of life straight into a client-side frame
+ *           buffer. The grid is axis-aligned and snapped to whole pixels, so
+ *           every cell is a run of identical pixels on a few rows.
+ *
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gol.h"
+#include "render.h"
+
+/* Rows start on a cache line. */
+#define RENDER_ALIGN 64
+
+int render_buffer_stride(int width) {
+    const int align = RENDER_ALIGN / sizeof(uint32_t);
+    return (width + align - 1) & ~(align - 1);
+}
+
+bool render_buffer_init(struct render_buffer *buf, int width, int height) {
+    const int stride = render_buffer_stride(width);
+    void *pixels = NULL;
+    if (posix_memalign(&pixels, RENDER_ALIGN, (size_t)stride * height * sizeof(uint32_t)) != 0) {
+        return false;
+    }
+    render_buffer_wrap(buf, pixels, width, height, stride);
+    return true;
+}
+
+void render_buffer_wrap(struct render_buffer *buf, uint32_t *pixels, int width, int height, int stride) {
+    buf->pixels = pixels;
+    buf->width = width;
+    buf->height = height;
+    buf->stride = stride;
+}
+
+void render_buffer_free(struct render_buffer *buf) {
+    free(buf->pixels);
+    buf->pixels = NULL;
+}
+
+static inline void fill_span(uint32_t *dst, int len, uint32_t pixel) {
+    for (int i = 0; i < len; i++) {
+        dst[i] = pixel;
+    }
+}
+
+/*
+ * Fills the first row of the rectangle and copies it onto the others,
+ * memcpy being the fastest way to fill a row there is.
+ *
+ */
+void render_fill_rect(struct render_buffer *buf, int x, int y, int width, int height, uint32_t pixel) {
+    int x0 = (x < 0 ? 0 : x);
+    int y0 = (y < 0 ? 0 : y);
+    int x1 = (x + width > buf->width ? buf->width : x + width);
+    int y1 = (y + height > buf->height ? buf->height : y + height);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    uint32_t *first = buf->pixels + ((size_t)y0 * buf->stride) + x0;
+    fill_span(first, x1 - x0, pixel);
+    for (int row = y0 + 1; row < y1; row++) {
+        memcpy(buf->pixels + ((size_t)row * buf->stride) + x0, first, (x1 - x0) * sizeof(uint32_t));
+    }
+}
+
+/*
+ * Takes the lowest run of set bits out of a word of cells, and returns the
+ * number of its first bit and its length through *len.
+ *
+ */
+static inline int take_run(uint64_t *word, int *len) {
+    const int start = __builtin_ctzll(*word);
+    const uint64_t rest = ~(*word >> start);
+    *len = (rest != 0 ? __builtin_ctzll(rest) : 64);
+    *word &= (start + *len < 64 ? ~0ULL << (start + *len) : 0);
+    return start;
+}
+
+/*
+ * Every line of cells is rasterized as one row of pixels, spans of live
+ * cells on top of the background, which is then copied onto the other rows
+ * the line covers.
+ *
+ */
+void render_life(struct render_buffer *buf, const struct render_grid *grid, int x, int y, int width, int height) {
+    const int size = grid->size;
+    const int gx1 = grid->x + grid->width;
+    const int gy1 = grid->y + grid->height;
+    int x0 = (x < grid->x ? grid->x : x);
+    int y0 = (y < grid->y ? grid->y : y);
+    int x1 = (x + width < gx1 ? x + width : gx1);
+    int y1 = (y + height < gy1 ? y + height : gy1);
+    x0 = (x0 < 0 ? 0 : x0);
+    y0 = (y0 < 0 ? 0 : y0);
+    x1 = (x1 > buf->width ? buf->width : x1);
+    y1 = (y1 > buf->height ? buf->height : y1);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    gol_select(grid->screen);
+
+    /* Pixels beyond the last column and line of cells only show background. */
+    int life_x1 = (x1 < grid->x + (grid->cols * size) ? x1 : grid->x + (grid->cols * size));
+    int life_y1 = (y1 < grid->y + (grid->rows * size) ? y1 : grid->y + (grid->rows * size));
+    if (life_y1 < y1) {
+        render_fill_rect(buf, x0, life_y1 > y0 ? life_y1 : y0, x1 - x0, y1 - life_y1, grid->background);
+    }
+
+    for (int py = y0; py < life_y1;) {
+        const int line = (py - grid->y) / size;
+        const int line_end = (grid->y + ((line + 1) * size) < life_y1 ? grid->y + ((line + 1) * size) : life_y1);
+        uint32_t *first = buf->pixels + ((size_t)py * buf->stride);
+
+        fill_span(first + x0, x1 - x0, grid->background);
+        /* Live cells come a word of the line at a time, in runs. */
+        const uint64_t *cells = gol_line(line);
+        const int col_first = (x0 - grid->x) / size;
+        const int col_end = (life_x1 - grid->x + size - 1) / size;
+        for (int w = col_first / 64; w * 64 < col_end; w++) {
+            uint64_t word = cells[w];
+            if (w == col_first / 64) {
+                word &= ~0ULL << (col_first % 64);
+            }
+            if ((w + 1) * 64 > col_end) {
+                word &= ~0ULL >> (64 - (col_end - (w * 64)));
+            }
+            while (word != 0) {
+                int len;
+                const int col = (w * 64) + take_run(&word, &len);
+                int span_x0 = (grid->x + (col * size) > x0 ? grid->x + (col * size) : x0);
+                int span_x1 = (grid->x + ((col + len) * size) < life_x1 ? grid->x + ((col + len) * size) : life_x1);
+                fill_span(first + span_x0, span_x1 - span_x0, grid->foreground);
+            }
+        }
+
+        for (int row = py + 1; row < line_end; row++) {
+            memcpy(buf->pixels + ((size_t)row * buf->stride) + x0, first + x0, (x1 - x0) * sizeof(uint32_t));
+        }
+        py = line_end;
+    }
+}
+
+static bool tile_line_changed(const struct render_grid *grid, int line) {
+    for (int col = 0; col < grid->cols; col += gol_tile_cols()) {
+        if (gol_tile_changed(col, line)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Rows of simulation tiles in which nothing changed are skipped whole, and
+ * so are the tiles in the other rows. The cells that changed are told apart
+ * a word at a time, and filled in runs.
+ *
+ */
+void render_changed_cells(struct render_buffer *buf, const struct render_grid *grid) {
+    const int size = grid->size;
+    const int tile_lines = gol_tile_lines();
+    gol_select(grid->screen);
+    for (int line = 0; line < grid->rows; line++) {
+        if (line % tile_lines == 0 && !tile_line_changed(grid, line)) {
+            line += tile_lines - 1;
+            continue;
+        }
+        const uint64_t *cells = gol_line(line);
+        const uint64_t *before = gol_line_before(line);
+        const int py = grid->y + (line * size);
+        for (int w = 0; w * 64 < grid->cols; w++) {
+            if (!gol_tile_changed(w * 64, line)) {
+                continue;
+            }
+            const uint64_t diff = cells[w] ^ before[w];
+            if (diff != 0 && size == 1 && py < buf->height && grid->x + ((w + 1) * 64) <= buf->width) {
+                /* At a pixel a cell, writing the changed pixels one by one
+                 * costs less than finding their runs. The others are left
+                 * alone, an image (-i) may have been drawn over them. */
+                uint32_t *dst = buf->pixels + ((size_t)py * buf->stride) + grid->x + (w * 64);
+                for (uint64_t m = diff; m != 0; m &= m - 1) {
+                    const int bit = __builtin_ctzll(m);
+                    dst[bit] = ((cells[w] >> bit) & 1) ? grid->foreground : grid->background;
+                }
+                continue;
+            }
+            uint64_t born = diff & cells[w];
+            uint64_t died = diff & ~cells[w];
+            while (born != 0) {
+                int len;
+                const int col = (w * 64) + take_run(&born, &len);
+                render_fill_rect(buf, grid->x + (col * size), py, len * size, size, grid->foreground);
+            }
+            while (died != 0) {
+                int len;
+                const int col = (w * 64) + take_run(&died, &len);
+                render_fill_rect(buf, grid->x + (col * size), py, len * size, size, grid->background);
+            }
+        }
+    }
+}
@@ -0,0 +1,344 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * render_bench.c: measures whole frames, the game of life plus the unlock
+ *                 indicator, drawn offscreen without X11 or PAM.
+ *
+ * Every workload (screen layout, backend, indicator shown or hidden) runs in
+ * a forked child, so it starts from a fresh simulation. Each prints one JSON
+ * object per line on stdout with the frame rate and the per-frame latency
+ * percentiles. With --check, an image is drawn over the cells as with -i, and
+ * the last frame is compared with one painted whole.
+ *
+ */
+#include <err.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cairo.h>
+
+#include "gol.h"
+#include "render.h"
+#include "frame.h"
+#include "indicator.h"
+
+struct layout {
+    const char *name;
+    int width;
+    int height;
+    int nscreens;
+    struct frame_rect screens[2];
+    /* Of each screen, 0 for unknown. */
+    double dpis[2];
+};
+
+/* The last one is a 27" 4K screen next to a 24" 1080p one, which get cells
+ * of the same physical size. */
+static const struct layout layouts[] = {
+    {"1080p", 1920, 1080, 1, {{0, 0, 1920, 1080}}, {0}},
+    {"4k", 3840, 2160, 1, {{0, 0, 3840, 2160}}, {0}},
+    {"2x1080p", 3840, 1080, 2, {{0, 0, 1920, 1080}, {1920, 0, 1920, 1080}}, {0, 0}},
+    {"4k+1080p", 5760, 2160, 2, {{0, 0, 3840, 2160}, {3840, 0, 1920, 1080}}, {163, 92}},
+    {"8k", 7680, 4320, 1, {{0, 0, 7680, 4320}}, {0}},
+};
+
+enum backend { BACKEND_PIXBUF, BACKEND_CAIRO };
+
+static const char *backend_names[] = {"pixbuf", "cairo"};
+
+struct workload {
+    const struct layout *layout;
+    enum backend backend;
+    bool indicator;
+};
+
+/* The throughput i3lock is meant to keep up: whole frames of an 8K screen
+ * with 1 px cells, at twice the default --gol-fps, on a single core. */
+#define TARGET_LAYOUT "8k"
+#define TARGET_CELL_SIZE 1
+#define TARGET_FPS 10.0
+/* Exit status of a workload which ran fine but missed TARGET_FPS. */
+#define EXIT_MISSED_TARGET 2
+
+static int frames = 300;
+static int threads = 0;
+static int cell_size = 10;
+static unsigned int seed = 1;
+static bool check = false;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* The given percentile of the sorted samples, nearest rank. */
+static double percentile(const double *sorted, int n, double p) {
+    int rank = (int)ceil(p / 100.0 * n);
+    rank = (rank < 1 ? 1 : (rank > n ? n : rank));
+    return sorted[rank - 1];
+}
+
+/* Sets up a frame of the given backend, over buffer for the pixel buffer. */
+static void open_frame(struct frame *frame, struct render_buffer *buffer, enum backend backend, int width, int height) {
+    if (backend == BACKEND_PIXBUF) {
+        if (!render_buffer_init(buffer, width, height)) {
+            errx(EXIT_FAILURE, "cannot allocate a %dx%d pixel buffer", width, height);
+        }
+        frame_init_buffer(frame, buffer);
+    } else {
+        cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+        frame_init(frame, surface, width, height);
+        cairo_surface_destroy(surface);
+    }
+}
+
+/* A translucent checkerboard, tiled over the cells as -i -t would. Its size
+ * matches neither the cells nor the words of the grid. */
+static cairo_surface_t *check_image(void) {
+    cairo_surface_t *img = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 37, 23);
+    cairo_t *ctx = cairo_create(img);
+    cairo_set_source_rgba(ctx, 0.8, 0.1, 0.3, 0.5);
+    cairo_paint(ctx);
+    cairo_rectangle(ctx, 0, 0, 18, 11);
+    cairo_rectangle(ctx, 18, 11, 19, 12);
+    cairo_set_source_rgba(ctx, 0.1, 0.7, 0.2, 0.25);
+    cairo_fill(ctx);
+    cairo_destroy(ctx);
+    return img;
+}
+
+/* Whether the frame shows the same pixels as the scene painted whole. */
+static bool same_as_full_repaint(struct frame *frame, const struct frame_scene *scene, enum backend backend) {
+    struct render_buffer buffer = {0};
+    struct frame full;
+    open_frame(&full, &buffer, backend, frame->width, frame->height);
+    frame_draw(&full, scene);
+    cairo_surface_flush(frame->surface);
+    cairo_surface_flush(full.surface);
+    const unsigned char *a = cairo_image_surface_get_data(frame->surface);
+    const unsigned char *b = cairo_image_surface_get_data(full.surface);
+    const int stride = cairo_image_surface_get_stride(frame->surface);
+    bool same = (stride == cairo_image_surface_get_stride(full.surface));
+    for (int y = 0; same && y < frame->height; y++) {
+        same = (memcmp(a + ((size_t)y * stride), b + ((size_t)y * stride), frame->width * sizeof(uint32_t)) == 0);
+    }
+    frame_free(&full);
+    render_buffer_free(&buffer);
+    return same;
+}
+
+static double run(const struct workload *w) {
+    const struct layout *l = w->layout;
+    unsigned int widths[2], heights[2];
+    for (int i = 0; i < l->nscreens; i++) {
+        widths[i] = l->screens[i].width;
+        heights[i] = l->screens[i].height;
+    }
+
+    srand(seed);
+    gol_set_cell_size(cell_size);
+    gol_set_threads(threads);
+    gol_init_screens(l->nscreens, widths, heights, l->dpis);
+    struct render_grid life[2];
+    long cells = 0;
+    for (int i = 0; i < l->nscreens; i++) {
+        unsigned int cols, rows, size;
+        gol_select(i);
+        gol_grid(&cols, &rows, &size);
+        life[i] = (struct render_grid){
+            .screen = i,
+            .x = l->screens[i].x,
+            .y = l->screens[i].y,
+            .width = l->screens[i].width,
+            .height = l->screens[i].height,
+            .cols = cols,
+            .rows = rows,
+            .size = size,
+            .background = 0x1f3a5c,
+            .foreground = 0xe0c5a3,
+        };
+        cells += (long)cols * rows;
+    }
+
+    struct render_buffer buffer = {0};
+    struct frame frame;
+    open_frame(&frame, &buffer, w->backend, l->width, l->height);
+
+    /* Someone typing: the indicator is drawn again on every frame. */
+    const struct indicator_state typing = {
+        .unlock_state = STATE_KEY_ACTIVE,
+        .auth_state = STATE_AUTH_IDLE,
+    };
+    const struct frame_scene scene = {
+        .life = life,
+        .nlife = l->nscreens,
+        .img = (check ? check_image() : NULL),
+        .tile = true,
+        .scaling_factor = 1.0,
+        .indicator = (w->indicator ? &typing : NULL),
+        .screens = l->screens,
+        .nscreens = l->nscreens,
+    };
+
+    /* The first frame starts the worker threads and paints everything, keep
+     * it out of the timing. */
+    gol_update();
+    frame_draw(&frame, &scene);
+
+    double *latency = malloc(frames * sizeof(double));
+    if (latency == NULL) {
+        err(EXIT_FAILURE, "malloc");
+    }
+    double render_seconds = 0;
+    const double start = now();
+    for (int i = 0; i < frames; i++) {
+        const double frame_start = now();
+        gol_update();
+        const double render_start = now();
+        frame_draw(&frame, &scene);
+        const double frame_end = now();
+        latency[i] = frame_end - frame_start;
+        render_seconds += frame_end - render_start;
+    }
+    const double seconds = now() - start;
+    qsort(latency, frames, sizeof(double), compare_doubles);
+    if (check && !same_as_full_repaint(&frame, &scene, w->backend)) {
+        errx(EXIT_FAILURE, "%s %s: the frames drawn differ from a full repaint", l->name, backend_names[w->backend]);
+    }
+
+    printf("{\"layout\": \"%s\", \"width\": %d, \"height\": %d, \"screens\": %d, "
+           "\"backend\": \"%s\", \"indicator\": %s, \"cells\": %ld, \"cell_size\": %d, "
+           "\"threads\": %d, \"frames\": %d, \"seconds\": %.6f, \"fps\": %.1f, \"render_share\": %.3f, "
+           "\"p50_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}\n",
+           l->name, l->width, l->height, l->nscreens,
+           backend_names[w->backend], w->indicator ? "true" : "false", cells, life[0].size,
+           threads, frames, seconds, frames / seconds, render_seconds / seconds,
+           percentile(latency, frames, 50) * 1e3, percentile(latency, frames, 95) * 1e3,
+           percentile(latency, frames, 99) * 1e3, latency[frames - 1] * 1e3);
+    fflush(stdout);
+
+    free(latency);
+    if (scene.img != NULL) {
+        cairo_surface_destroy(scene.img);
+    }
+    frame_free(&frame);
+    render_buffer_free(&buffer);
+    return frames / seconds;
+}
+
+int main(int argc, char *argv[]) {
+    int only_backend = -1;
+    bool target = false;
+    int o;
+    struct option longopts[] = {
+        {"frames", required_argument, NULL, 'f'},
+        {"threads", required_argument, NULL, 't'},
+        {"seed", required_argument, NULL, 's'},
+        {"cell-size", required_argument, NULL, 'c'},
+        {"backend", required_argument, NULL, 'b'},
+        {"target", no_argument, NULL, 'T'},
+        {"check", no_argument, NULL, 'C'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, no_argument, NULL, 0}};
+
+    while ((o = getopt_long(argc, argv, "f:t:s:c:b:TCh", longopts, NULL)) != -1) {
+        switch (o) {
+            case 'f':
+                if (sscanf(optarg, "%d", &frames) != 1 || frames < 1) {
+                    errx(EXIT_FAILURE, "frames must be a positive number");
+                }
+                break;
+            case 't':
+                if (sscanf(optarg, "%d", &threads) != 1 || threads < 0) {
+                    errx(EXIT_FAILURE, "threads must be a number of threads (0 for one per CPU)");
+                }
+                break;
+            case 's':
+                if (sscanf(optarg, "%u", &seed) != 1) {
+                    errx(EXIT_FAILURE, "seed must be a number");
+                }
+                break;
+            case 'c':
+                if (sscanf(optarg, "%d", &cell_size) != 1 || cell_size < 1) {
+                    errx(EXIT_FAILURE, "cell-size must be a positive number of pixels");
+                }
+                break;
+            case 'b':
+                for (int b = 0; b < (int)(sizeof(backend_names) / sizeof(backend_names[0])); b++) {
+                    if (strcmp(optarg, backend_names[b]) == 0) {
+                        only_backend = b;
+                    }
+                }
+                if (only_backend == -1) {
+                    errx(EXIT_FAILURE, "backend must be pixbuf or cairo");
+                }
+                break;
+            case 'T':
+                target = true;
+                break;
+            case 'C':
+                check = true;
+                break;
+            default:
+                errx(EXIT_FAILURE, "Syntax: render-bench [-f frames] [-t threads] [-s seed] "
+                                   "[-c cell-size] [-b pixbuf|cairo] [-T] [-C]");
+        }
+    }
+
+    /* Checking the target only runs the one workload it is about. */
+    if (target) {
+        cell_size = TARGET_CELL_SIZE;
+        threads = 1;
+        only_backend = BACKEND_PIXBUF;
+    }
+
+    const int nlayouts = sizeof(layouts) / sizeof(layouts[0]);
+    bool failed = false;
+    for (int l = 0; l < nlayouts; l++) {
+        if (target && strcmp(layouts[l].name, TARGET_LAYOUT) != 0) {
+            continue;
+        }
+        for (int b = BACKEND_PIXBUF; b <= BACKEND_CAIRO; b++) {
+            if (only_backend != -1 && b != only_backend) {
+                continue;
+            }
+            for (int i = 1; i >= 0; i--) {
+                if (target && i == 1) {
+                    continue;
+                }
+                const struct workload w = {&layouts[l], b, i == 1};
+                pid_t pid = fork();
+                if (pid == -1) {
+                    err(EXIT_FAILURE, "fork");
+                }
+                if (pid == 0) {
+                    const double fps = run(&w);
+                    exit((target && fps < TARGET_FPS) ? EXIT_MISSED_TARGET : EXIT_SUCCESS);
+                }
+                int status;
+                if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) ||
+                    (WEXITSTATUS(status) != 0 && WEXITSTATUS(status) != EXIT_MISSED_TARGET)) {
+                    warnx("workload %s %s indicator %d failed", w.layout->name, backend_names[b], w.indicator);
+                    failed = true;
+                } else if (WEXITSTATUS(status) == EXIT_MISSED_TARGET) {
+                    warnx("%s with %d px cells is below the target of %.0f fps", w.layout->name, cell_size, TARGET_FPS);
+                    failed = true;
+                }
+            }
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
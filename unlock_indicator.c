@@ -7,11 +7,12 @@
  *
  */
 #include <stdbool.h>
+#include <err.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <math.h>
 #include <xcb/xcb.h>
+#include <xcb/xcb_aux.h>
 #include <xkbcommon/xkbcommon.h>
 #include <ev.h>
 #include <cairo.h>
@@ -20,15 +21,14 @@
 #include "i3lock.h"
 #include "xcb.h"
 #include "gol.h"
+#include "render.h"
+#include "frame.h"
+#include "frame_stats.h"
 #include "unlock_indicator.h"
+#include "present.h"
 #include "randr.h"
 #include "dpi.h"
 
-#define BUTTON_RADIUS 90
-#define BUTTON_SPACE (BUTTON_RADIUS + 5)
-#define BUTTON_CENTER (BUTTON_RADIUS + 5)
-#define BUTTON_DIAMETER (2 * BUTTON_SPACE)
-
 /*******************************************************************************
  * Variables defined in i3lock.c.
  ******************************************************************************/
@@ -58,6 +58,9 @@ extern cairo_surface_t *img;
 
 /* Whether the image should be tiled. */
 extern bool tile;
+/* Whether the game of life is drawn with cairo instead of being rasterized
+ * into a client-side buffer. */
+extern bool render_cairo;
 /* The background color to use (in hex). */
 extern char color[7];
 
@@ -102,25 +105,6 @@ static void string_append(char **string_ptr, const char *appended) {
     }
 }
 
-static void display_button_text(
-    cairo_t *ctx, const char *text, double y_offset, bool use_dark_text) {
-    cairo_text_extents_t extents;
-    double x, y;
-
-    cairo_text_extents(ctx, text, &extents);
-    x = BUTTON_CENTER - ((extents.width / 2) + extents.x_bearing);
-    y = BUTTON_CENTER - ((extents.height / 2) + extents.y_bearing) + y_offset;
-
-    cairo_move_to(ctx, x, y);
-    if (use_dark_text) {
-        cairo_set_source_rgb(ctx, 0., 0., 0.);
-    } else {
-        cairo_set_source_rgb(ctx, 1., 1., 1.);
-    }
-    cairo_show_text(ctx, text);
-    cairo_close_path(ctx);
-}
-
 static void update_layout_string() {
     if (layout_string) {
         free(layout_string);
@@ -169,292 +153,336 @@ static void check_modifier_keys(void) {
     }
 }
 
+/* The game of life grids, one per screen, with the size of their cells in
+ * pixels and their colors, picked at random by init_life(). */
+static struct render_grid *life = NULL;
+static int nlife = 0;
+
+/* The frame drawn onto the pixmap, along with the pixmap, kept across
+ * draw_image() calls so that the next call only needs to repaint what changed
+ * since. It is rebuilt by update_render_state() when the pixmap or its
+ * resolution change. */
+static struct {
+    xcb_pixmap_t pixmap;
+    uint32_t resolution[2];
+    /* Drawn on the pixmap itself, or on the client-side buffer in
+     * frame.buffer, which is uploaded to the pixmap afterwards. */
+    struct frame frame;
+    xcb_gcontext_t gc;
+    /* Set when the buffer lives in shared memory (MIT-SHM), in which case
+     * the X server reads it directly when uploading. */
+    bool shm;
+    struct shm_segment shm_segment;
+    /* Whether the X server may still be reading the shared buffer. */
+    bool shm_pending;
+    /* Time spent by the last draw_image() call getting the frame to the X
+     * server, counted as part of presenting it. */
+    double upload_seconds;
+} render = {.pixmap = XCB_NONE};
+
+static void free_render_state(void) {
+    if (render.pixmap == XCB_NONE) {
+        return;
+    }
+    struct render_buffer buffer = render.frame.buffer;
+    frame_free(&render.frame);
+    if (buffer.pixels != NULL) {
+        if (render.shm) {
+            shm_segment_destroy(conn, &render.shm_segment);
+        } else {
+            render_buffer_free(&buffer);
+        }
+        xcb_free_gc(conn, render.gc);
+    }
+    render.pixmap = XCB_NONE;
+}
+
 /*
- * Draws global image with fill color onto a pixmap with the given
- * resolution and returns it.
+ * Sets up rasterizing into a client-side buffer, unless the cairo backend
+ * was requested, the visual has no plain 32 bit pixels or memory is short.
+ * The buffer is shared with the X server when possible, and uploaded through
+ * the socket otherwise.
  *
  */
-void draw_image(xcb_pixmap_t bg_pixmap, uint32_t *resolution, bool tick) {
-    const double scaling_factor = get_dpi_value() / 96.0;
-    int button_diameter_physical = ceil(scaling_factor * BUTTON_DIAMETER);
-    DEBUG("scaling_factor is %.f, physical diameter is %d px\n",
-          scaling_factor, button_diameter_physical);
+static bool init_render_buffer(xcb_pixmap_t bg_pixmap, uint32_t *resolution) {
+    static bool warned = false;
+    if (render_cairo) {
+        return false;
+    }
+    if (!visual_is_rgb24(conn, screen)) {
+        goto fallback;
+    }
+
+    const int stride = render_buffer_stride(resolution[0]);
+    const size_t size = (size_t)stride * resolution[1] * sizeof(uint32_t);
+    struct render_buffer buffer;
+    render.shm = shm_segment_create(conn, size, &render.shm_segment);
+    render.shm_pending = false;
+    if (render.shm) {
+        render_buffer_wrap(&buffer, render.shm_segment.addr, resolution[0], resolution[1], stride);
+    } else if (!render_buffer_init(&buffer, resolution[0], resolution[1])) {
+        goto fallback;
+    }
+    DEBUG("rendering into a %s pixel buffer\n", render.shm ? "shared memory" : "client-side");
+
+    frame_init_buffer(&render.frame, &buffer);
+    render.gc = xcb_generate_id(conn);
+    xcb_create_gc(conn, render.gc, bg_pixmap, 0, NULL);
+    return true;
+
+fallback:
+    if (!warned) {
+        fprintf(stderr, "i3lock: cannot render into a pixel buffer, falling back to cairo\n");
+        warned = true;
+    }
+    return false;
+}
+
+/*
+ * Rebuilds the render state if it does not match the given pixmap and
+ * resolution.
+ *
+ */
+static void update_render_state(xcb_pixmap_t bg_pixmap, uint32_t *resolution) {
+    if (render.pixmap == bg_pixmap &&
+        render.resolution[0] == resolution[0] && render.resolution[1] == resolution[1]) {
+        return;
+    }
+    free_render_state();
 
     if (!vistype) {
         vistype = get_root_visual_type(screen);
     }
 
-    /* Initialize cairo: Create one in-memory surface to render the unlock
-     * indicator on, create one XCB surface to actually draw (one or more,
-     * depending on the amount of screens) unlock indicators on. */
-    cairo_surface_t *output = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, button_diameter_physical, button_diameter_physical);
-    cairo_t *ctx = cairo_create(output);
-
-    cairo_surface_t *gol_output = cairo_xcb_surface_create(conn, bg_pixmap, vistype, resolution[0], resolution[1]);
-    cairo_t *gol_ctx = cairo_create(gol_output);
-
-    cairo_surface_t *xcb_output = cairo_xcb_surface_create(conn, bg_pixmap, vistype, resolution[0], resolution[1]);
-    cairo_t *xcb_ctx = cairo_create(xcb_output);
-
-    /* After the first iteration, the pixmap will still contain the previous
-     * contents. Explicitly clear the entire pixmap with the background color
-     * first to get back into a defined state: */
-    static int gol_ready = 0;
-    static unsigned int gol_cols = 1;
-    static unsigned int gol_rows = 1;
-    static unsigned int gol_grid = 1;
-    static char gol_color[7];
-    static char gol_color_neg[7];
-    if (gol_ready == 0) {
-        gol_ready = 1;
-        gol_init(resolution[0], resolution[1], &gol_cols, &gol_rows, &gol_grid);
-
-        // get a random color
-        srand((unsigned int)time(NULL));
-        int randomColor = rand() % 0x1000000;
-        sprintf(gol_color, "%06x", randomColor);
-        gol_color[6] = '\0';
-        int oppositeColor = 0xFFFFFF ^ randomColor;
-        sprintf(gol_color_neg, "%06x", oppositeColor);
-        gol_color_neg[6] = '\0';
-    }
-
-    char strgroups[3][3] = {{gol_color[0], gol_color[1], '\0'},
-                            {gol_color[2], gol_color[3], '\0'},
-                            {gol_color[4], gol_color[5], '\0'}};
-    uint32_t rgb16[3] = {(strtol(strgroups[0], NULL, 16)),
-                         (strtol(strgroups[1], NULL, 16)),
-                         (strtol(strgroups[2], NULL, 16))};
-    cairo_set_source_rgb(xcb_ctx, rgb16[0] / 255.0, rgb16[1] / 255.0, rgb16[2] / 255.0);
-    cairo_rectangle(xcb_ctx, 0, 0, resolution[0], resolution[1]);
-    cairo_fill(xcb_ctx);
-
-    if (tick) {
-        gol_update();
-    }
-
-    char strgroups_cel[3][3] = {{gol_color_neg[0], gol_color_neg[1], '\0'},
-                            {gol_color_neg[2], gol_color_neg[3], '\0'},
-                            {gol_color_neg[4], gol_color_neg[5], '\0'}};
-    uint32_t rgb16_cel[3] = {(strtol(strgroups_cel[0], NULL, 16)),
-                         (strtol(strgroups_cel[1], NULL, 16)),
-                         (strtol(strgroups_cel[2], NULL, 16))};
-    // draw life
-    for (unsigned int row = 0; row < gol_rows; row++) {
-        for (unsigned int col = 0; col < gol_cols; col++) {
-            if (gol_cell_is_alive(col, row)) {
-                cairo_set_source_rgb(gol_ctx, rgb16_cel[0] / 255.0, rgb16_cel[1] / 255.0, rgb16_cel[2] / 255.0);
-                cairo_rectangle(gol_ctx, gol_grid * col, gol_grid * row, gol_grid, gol_grid);
-                cairo_fill(gol_ctx);
-            }
-        }
+    if (!init_render_buffer(bg_pixmap, resolution)) {
+        cairo_surface_t *surface = cairo_xcb_surface_create(conn, bg_pixmap, vistype, resolution[0], resolution[1]);
+        frame_init(&render.frame, surface, resolution[0], resolution[1]);
+        cairo_surface_destroy(surface);
     }
-    cairo_set_source_surface(gol_ctx, output, 0, 0);
 
-    if (img) {
-        if (!tile) {
-            cairo_set_source_surface(xcb_ctx, img, 0, 0);
-            cairo_paint(xcb_ctx);
-        } else {
-            /* create a pattern and fill a rectangle as big as the screen */
-            cairo_pattern_t *pattern;
-            pattern = cairo_pattern_create_for_surface(img);
-            cairo_set_source(xcb_ctx, pattern);
-            cairo_pattern_set_extend(pattern, CAIRO_EXTEND_REPEAT);
-            cairo_rectangle(xcb_ctx, 0, 0, resolution[0], resolution[1]);
-            cairo_fill(xcb_ctx);
-            cairo_pattern_destroy(pattern);
-        }
+    render.pixmap = bg_pixmap;
+    render.resolution[0] = resolution[0];
+    render.resolution[1] = resolution[1];
+}
+
+/*
+ * The DPI of a screen from its physical size, or 0 when it is unknown. Some
+ * EDIDs report nonsense, like the aspect ratio in centimeters, so anything
+ * outside of what screens actually have counts as unknown too.
+ *
+ */
+static double screen_dpi(const Rect *rect) {
+    if (rect->mm_width == 0) {
+        return 0;
     }
+    const double dpi = rect->width * 25.4 / rect->mm_width;
+    return (dpi >= 48 && dpi <= 600 ? dpi : 0);
+}
 
-    if (unlock_indicator &&
-        (unlock_state >= STATE_KEY_PRESSED || auth_state > STATE_AUTH_IDLE)) {
-        cairo_scale(ctx, scaling_factor, scaling_factor);
-        /* Draw a (centered) circle with transparent background. */
-        cairo_set_line_width(ctx, 10.0);
-        cairo_arc(ctx,
-                  BUTTON_CENTER /* x */,
-                  BUTTON_CENTER /* y */,
-                  BUTTON_RADIUS /* radius */,
-                  0 /* start */,
-                  2 * M_PI /* end */);
-
-        /* Use the appropriate color for the different PAM states
-         * (currently verifying, wrong password, or default) */
-        switch (auth_state) {
-            case STATE_AUTH_VERIFY:
-            case STATE_AUTH_LOCK:
-                cairo_set_source_rgba(ctx, 0, 114.0 / 255, 255.0 / 255, 0.75);
-                break;
-            case STATE_AUTH_WRONG:
-            case STATE_I3LOCK_LOCK_FAILED:
-                cairo_set_source_rgba(ctx, 250.0 / 255, 0, 0, 0.75);
-                break;
-            default:
-                if (unlock_state == STATE_NOTHING_TO_DELETE) {
-                    cairo_set_source_rgba(ctx, 250.0 / 255, 0, 0, 0.75);
-                    break;
-                }
-                cairo_set_source_rgba(ctx, 0, 0, 0, 0.75);
-                break;
-        }
-        cairo_fill_preserve(ctx);
-
-        bool use_dark_text = true;
-
-        switch (auth_state) {
-            case STATE_AUTH_VERIFY:
-            case STATE_AUTH_LOCK:
-                cairo_set_source_rgb(ctx, 51.0 / 255, 0, 250.0 / 255);
-                break;
-            case STATE_AUTH_WRONG:
-            case STATE_I3LOCK_LOCK_FAILED:
-                cairo_set_source_rgb(ctx, 125.0 / 255, 51.0 / 255, 0);
-                break;
-            case STATE_AUTH_IDLE:
-                if (unlock_state == STATE_NOTHING_TO_DELETE) {
-                    cairo_set_source_rgb(ctx, 125.0 / 255, 51.0 / 255, 0);
-                    break;
-                }
-
-                cairo_set_source_rgb(ctx, 51.0 / 255, 125.0 / 255, 0);
-                use_dark_text = false;
-                break;
+/*
+ * Whether the screens, or the root window when there are none, changed since
+ * the last call, which is the first one.
+ *
+ */
+static bool screens_changed(uint32_t *resolution) {
+    static Rect *rects = NULL;
+    static int nrects = -1;
+    static uint32_t root[2];
+    if (nrects == xr_screens &&
+        (xr_screens > 0 ? memcmp(rects, xr_resolutions, xr_screens * sizeof(Rect)) == 0
+                        : (root[0] == resolution[0] && root[1] == resolution[1]))) {
+        return false;
+    }
+    free(rects);
+    rects = malloc((xr_screens > 0 ? xr_screens : 1) * sizeof(Rect));
+    if (rects == NULL) {
+        err(EXIT_FAILURE, "malloc");
+    }
+    if (xr_screens > 0) {
+        memcpy(rects, xr_resolutions, xr_screens * sizeof(Rect));
+    }
+    nrects = xr_screens;
+    root[0] = resolution[0];
+    root[1] = resolution[1];
+    return true;
+}
+
+/*
+ * Starts one game per screen, with cells of the same physical size on all
+ * of them, so that none is spent on the parts of the root window no screen
+ * shows. Screens showing the same part of it (mirrored) share one. Called
+ * again, the games are started anew for the current screens, in the same
+ * colors.
+ *
+ */
+static void init_life(uint32_t *resolution) {
+    /* Without RandR or Xinerama, the root window is the one screen. */
+    const Rect root = {0, 0, resolution[0], resolution[1], 0, 0};
+    const Rect *rects = (xr_screens > 0 ? xr_resolutions : &root);
+    const int nrects = (xr_screens > 0 ? xr_screens : 1);
+
+    free(life);
+    nlife = 0;
+    life = calloc(nrects, sizeof(struct render_grid));
+    unsigned int *widths = calloc(nrects, sizeof(unsigned int));
+    unsigned int *heights = calloc(nrects, sizeof(unsigned int));
+    double *dpis = calloc(nrects, sizeof(double));
+    if (life == NULL || widths == NULL || heights == NULL || dpis == NULL) {
+        err(EXIT_FAILURE, "calloc");
+    }
+    for (int i = 0; i < nrects; i++) {
+        bool mirrored = false;
+        for (int j = 0; j < nlife; j++) {
+            if (life[j].x == rects[i].x && life[j].y == rects[i].y &&
+                life[j].width == rects[i].width && life[j].height == rects[i].height) {
+                mirrored = true;
+            }
         }
-        cairo_stroke(ctx);
-
-        /* Draw an inner seperator line. */
-        cairo_set_source_rgb(ctx, 0, 0, 0);
-        cairo_set_line_width(ctx, 2.0);
-        cairo_arc(ctx,
-                  BUTTON_CENTER /* x */,
-                  BUTTON_CENTER /* y */,
-                  BUTTON_RADIUS - 5 /* radius */,
-                  0,
-                  2 * M_PI);
-        cairo_stroke(ctx);
-
-        cairo_set_line_width(ctx, 10.0);
-
-        /* Display a (centered) text of the current PAM state. */
-        char *text = NULL;
-        /* We don't want to show more than a 3-digit number. */
-        char buf[4];
-
-        cairo_set_source_rgb(ctx, 0, 0, 0);
-        cairo_select_font_face(ctx, "sans-serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-        cairo_set_font_size(ctx, 28.0);
-        switch (auth_state) {
-            case STATE_AUTH_VERIFY:
-                text = "Verifying…";
-                break;
-            case STATE_AUTH_LOCK:
-                text = "Locking…";
-                break;
-            case STATE_AUTH_WRONG:
-                text = "Wrong!";
-                break;
-            case STATE_I3LOCK_LOCK_FAILED:
-                text = "Lock failed!";
-                break;
-            default:
-                if (unlock_state == STATE_NOTHING_TO_DELETE) {
-                    text = "No input";
-                }
-                if (show_failed_attempts && failed_attempts > 0) {
-                    if (failed_attempts > 999) {
-                        text = "> 999";
-                    } else {
-                        snprintf(buf, sizeof(buf), "%d", failed_attempts);
-                        text = buf;
-                    }
-                    cairo_set_source_rgb(ctx, 1, 0, 0);
-                    cairo_set_font_size(ctx, 32.0);
-                }
-                break;
+        if (mirrored) {
+            continue;
         }
+        life[nlife] = (struct render_grid){
+            .screen = nlife,
+            .x = rects[i].x,
+            .y = rects[i].y,
+            .width = rects[i].width,
+            .height = rects[i].height,
+        };
+        widths[nlife] = rects[i].width;
+        heights[nlife] = rects[i].height;
+        dpis[nlife] = screen_dpi(&rects[i]);
+        nlife++;
+    }
+    nlife = gol_init_screens(nlife, widths, heights, dpis);
 
-        if (text) {
-            display_button_text(ctx, text, 0., use_dark_text);
-        }
+    // get a random color
+    static int randomColor = -1;
+    if (randomColor < 0) {
+        srand((unsigned int)time(NULL));
+        randomColor = rand() % 0x1000000;
+    }
+    for (int i = 0; i < nlife; i++) {
+        unsigned int cols, rows, grid;
+        gol_select(i);
+        gol_grid(&cols, &rows, &grid);
+        DEBUG("gol: screen %d: %u x %u cells of %u px (%.0f DPI), %s kernel\n",
+              i, cols, rows, grid, dpis[i], gol_kernel_name());
+        life[i].cols = cols;
+        life[i].rows = rows;
+        life[i].size = grid;
+        life[i].background = randomColor;
+        life[i].foreground = 0xFFFFFF ^ randomColor;
+    }
+    free(widths);
+    free(heights);
+    free(dpis);
+}
 
-        if (modifier_string != NULL) {
-            cairo_set_font_size(ctx, 14.0);
-            display_button_text(ctx, modifier_string, 28., use_dark_text);
-        }
-        if (show_keyboard_layout && layout_string != NULL) {
-            cairo_set_font_size(ctx, 14.0);
-            display_button_text(ctx, layout_string, -28., use_dark_text);
-        }
+/*
+ * Converts a damaged region of the frame into an X rectangle.
+ *
+ */
+static xcb_rectangle_t damage_rectangle(const struct frame_rect *r) {
+    return (xcb_rectangle_t){r->x, r->y, r->width, r->height};
+}
+
+/*
+ * Draws global image with fill color onto a pixmap with the given
+ * resolution and returns it.
+ *
+ * The pixmap keeps the previous contents, so when it was drawn by the last
+ * call and the simulation advanced by at most one step, only the cells
+ * that changed and the unlock indicator are repainted. The repainted regions
+ * are recorded as damage for redraw_screen().
+ *
+ */
+void draw_image(xcb_pixmap_t bg_pixmap, uint32_t *resolution) {
+    const double scaling_factor = get_dpi_value() / 96.0;
+    /* Logged when it changes only, draw_image() runs once per frame. */
+    static double last_scaling_factor = 0;
+    if (scaling_factor != last_scaling_factor) {
+        last_scaling_factor = scaling_factor;
+        DEBUG("scaling_factor is %.f, physical diameter is %d px\n",
+              scaling_factor, indicator_diameter(scaling_factor));
+    }
+
+    /* RandR may have added, removed or resized screens since the last frame. */
+    const bool life_changed = screens_changed(resolution);
+    if (life_changed) {
+        init_life(resolution);
+    }
 
-        /* After the user pressed any valid key or the backspace key, we
-         * highlight a random part of the unlock indicator to confirm this
-         * keypress. */
-        if (unlock_state == STATE_KEY_ACTIVE ||
-            unlock_state == STATE_BACKSPACE_ACTIVE) {
-            cairo_new_sub_path(ctx);
-            double highlight_start = (rand() % (int)(2 * M_PI * 100)) / 100.0;
-            cairo_arc(ctx,
-                      BUTTON_CENTER /* x */,
-                      BUTTON_CENTER /* y */,
-                      BUTTON_RADIUS /* radius */,
-                      highlight_start,
-                      highlight_start + (M_PI / 3.0));
-            if (unlock_state == STATE_KEY_ACTIVE) {
-                /* For normal keys, we use a lighter green. */
-                cairo_set_source_rgb(ctx, 51.0 / 255, 219.0 / 255, 0);
+    update_render_state(bg_pixmap, resolution);
+    if (life_changed) {
+        /* The new games start at generation 0, which the frame may hold. */
+        render.frame.drawn = false;
+    }
+    double upload_start = frame_stats_now();
+    if (render.shm_pending) {
+        /* Wait for the X server to be done with the last frame. */
+        xcb_aux_sync(conn);
+        render.shm_pending = false;
+    }
+    render.upload_seconds = frame_stats_now() - upload_start;
+
+    const struct indicator_state state = {
+        .unlock_state = unlock_state,
+        .auth_state = auth_state,
+        .failed_attempts = (show_failed_attempts ? failed_attempts : 0),
+        .modifier_string = modifier_string,
+        .layout_string = (show_keyboard_layout ? layout_string : NULL),
+    };
+    const bool indicator = unlock_indicator &&
+                           (unlock_state >= STATE_KEY_PRESSED || auth_state > STATE_AUTH_IDLE);
+
+    /* The unlock indicator goes in the middle of each screen. */
+    static struct frame_rect *screens = NULL;
+    static int screens_size = 0;
+    int nscreens = xr_screens;
+    if (nscreens > screens_size) {
+        screens = realloc(screens, nscreens * sizeof(struct frame_rect));
+        if (screens == NULL) {
+            err(EXIT_FAILURE, "realloc");
+        }
+        screens_size = nscreens;
+    }
+    for (int i = 0; i < nscreens; i++) {
+        screens[i] = (struct frame_rect){xr_resolutions[i].x, xr_resolutions[i].y,
+                                         xr_resolutions[i].width, xr_resolutions[i].height};
+    }
+    /* We have no information about the screen sizes/positions, so we just
+     * place the unlock indicator in the middle of the X root window and
+     * hope for the best. */
+    struct frame_rect root = {0, 0, last_resolution[0], last_resolution[1]};
+
+    const struct frame_scene scene = {
+        .life = life,
+        .nlife = nlife,
+        .img = img,
+        .tile = tile,
+        .scaling_factor = scaling_factor,
+        .indicator = (indicator ? &state : NULL),
+        .screens = (nscreens > 0 ? screens : &root),
+        .nscreens = (nscreens > 0 ? nscreens : 1),
+    };
+    frame_draw(&render.frame, &scene);
+
+    upload_start = frame_stats_now();
+    const struct render_buffer *buffer = &render.frame.buffer;
+    if (buffer->pixels != NULL) {
+        for (int i = 0; i < render.frame.damage_len; i++) {
+            const xcb_rectangle_t rect = damage_rectangle(&render.frame.damage[i]);
+            if (render.shm) {
+                shm_put_pixels(conn, bg_pixmap, render.gc, screen->root_depth, &render.shm_segment,
+                               buffer->stride, buffer->height, rect);
             } else {
-                /* For backspace, we use red. */
-                cairo_set_source_rgb(ctx, 219.0 / 255, 51.0 / 255, 0);
+                put_pixels(conn, bg_pixmap, render.gc, screen->root_depth,
+                           buffer->pixels, buffer->stride, rect);
             }
-            cairo_stroke(ctx);
-
-            /* Draw two little separators for the highlighted part of the
-             * unlock indicator. */
-            cairo_set_source_rgb(ctx, 0, 0, 0);
-            cairo_arc(ctx,
-                      BUTTON_CENTER /* x */,
-                      BUTTON_CENTER /* y */,
-                      BUTTON_RADIUS /* radius */,
-                      highlight_start /* start */,
-                      highlight_start + (M_PI / 128.0) /* end */);
-            cairo_stroke(ctx);
-            cairo_arc(ctx,
-                      BUTTON_CENTER /* x */,
-                      BUTTON_CENTER /* y */,
-                      BUTTON_RADIUS /* radius */,
-                      (highlight_start + (M_PI / 3.0)) - (M_PI / 128.0) /* start */,
-                      highlight_start + (M_PI / 3.0) /* end */);
-            cairo_stroke(ctx);
         }
+        render.shm_pending = (render.shm && render.frame.damage_len > 0);
     }
-
-    if (xr_screens > 0) {
-        /* Composite the unlock indicator in the middle of each screen. */
-        for (int screen = 0; screen < xr_screens; screen++) {
-            int x = (xr_resolutions[screen].x + ((xr_resolutions[screen].width / 2) - (button_diameter_physical / 2)));
-            int y = (xr_resolutions[screen].y + ((xr_resolutions[screen].height / 2) - (button_diameter_physical / 2)));
-            cairo_set_source_surface(xcb_ctx, output, x, y);
-            cairo_rectangle(xcb_ctx, x, y, button_diameter_physical, button_diameter_physical);
-            cairo_fill(xcb_ctx);
-        }
-    } else {
-        /* We have no information about the screen sizes/positions, so we just
-         * place the unlock indicator in the middle of the X root window and
-         * hope for the best. */
-        int x = (last_resolution[0] / 2) - (button_diameter_physical / 2);
-        int y = (last_resolution[1] / 2) - (button_diameter_physical / 2);
-        cairo_set_source_surface(xcb_ctx, output, x, y);
-        cairo_rectangle(xcb_ctx, x, y, button_diameter_physical, button_diameter_physical);
-        cairo_fill(xcb_ctx);
-    }
-
-    cairo_surface_destroy(xcb_output);
-    cairo_surface_destroy(gol_output);
-    cairo_surface_destroy(output);
-    cairo_destroy(ctx);
-    cairo_destroy(gol_ctx);
-    cairo_destroy(xcb_ctx);
+    render.upload_seconds += frame_stats_now() - upload_start;
 }
 
 static xcb_pixmap_t bg_pixmap = XCB_NONE;
@@ -465,12 +493,69 @@ static xcb_pixmap_t bg_pixmap = XCB_NONE;
  *
  */
 void free_bg_pixmap(void) {
+    free_render_state();
     xcb_free_pixmap(conn, bg_pixmap);
     bg_pixmap = XCB_NONE;
 }
 
 /*
- * Calls draw_image on a new pixmap and swaps that with the current pixmap
+ * Draws the next frame onto the background pixmap, allocating it first if
+ * needed.
+ *
+ */
+static void render_frame(void) {
+    if (bg_pixmap == XCB_NONE) {
+        DEBUG("allocating pixmap for %d x %d px\n", last_resolution[0], last_resolution[1]);
+        bg_pixmap = create_bg_pixmap(conn, screen, last_resolution, color);
+        xcb_change_window_attributes(conn, win, XCB_CW_BACK_PIXMAP, (uint32_t[1]){bg_pixmap});
+    }
+
+    draw_image(bg_pixmap, last_resolution);
+    frame_stats_rendered();
+}
+
+/*
+ * Sends the regions of the background pixmap changed by render_frame() to
+ * the window. Nothing is sent when nothing changed.
+ *
+ * With vsync, they are shown through the Present extension at the next
+ * vertical blank that is due, which is then waited for even when nothing
+ * changed, since its completion drives the animation. Otherwise they are
+ * shown right away.
+ *
+ */
+static void present_frame(bool vsync) {
+    const double start = frame_stats_now();
+    if (vsync) {
+        static xcb_rectangle_t *rects = NULL;
+        static int rects_size = 0;
+        if (render.frame.damage_len > rects_size) {
+            rects_size = render.frame.damage_size;
+            rects = realloc(rects, rects_size * sizeof(xcb_rectangle_t));
+            if (rects == NULL) {
+                err(EXIT_FAILURE, "realloc");
+            }
+        }
+        for (int i = 0; i < render.frame.damage_len; i++) {
+            rects[i] = damage_rectangle(&render.frame.damage[i]);
+        }
+        present_schedule(bg_pixmap, rects, render.frame.damage_len);
+    } else if (render.frame.damage_len > 0) {
+        for (int i = 0; i < render.frame.damage_len; i++) {
+            const struct frame_rect *r = &render.frame.damage[i];
+            xcb_clear_area(conn, 0, win, r->x, r->y, r->width, r->height);
+        }
+        xcb_flush(conn);
+    }
+    if (render.frame.damage_len > 0) {
+        frame_stats_record(FRAME_STAGE_PRESENT, render.upload_seconds + (frame_stats_now() - start));
+        frame_stats_presented();
+    }
+}
+
+/*
+ * Redraws the screen after the unlock/PAM state or the keyboard state
+ * changed.
  *
  */
 void redraw_screen(void) {
@@ -483,17 +568,27 @@ void redraw_screen(void) {
     check_modifier_keys();
     update_layout_string();
 
-    if (bg_pixmap == XCB_NONE) {
-        DEBUG("allocating pixmap for %d x %d px\n", last_resolution[0], last_resolution[1]);
-        bg_pixmap = create_bg_pixmap(conn, screen, last_resolution, color);
-    }
+    render_frame();
+    present_frame(false);
+}
 
-    draw_image(bg_pixmap, last_resolution, false);
-    xcb_change_window_attributes(conn, win, XCB_CW_BACK_PIXMAP, (uint32_t[1]){bg_pixmap});
-    /* XXX: Possible optimization: Only update the area in the middle of the
-     * screen instead of the whole screen. */
-    xcb_clear_area(conn, 0, win, 0, 0, last_resolution[0], last_resolution[1]);
-    xcb_flush(conn);
+/*
+ * Advances the game of life by one step and shows it. This is the
+ * whole frame pipeline of the animation: simulate, render and present, each
+ * exactly once. It runs off a timer, or off the completion of the previous
+ * frame when frames are paced by the Present extension.
+ *
+ */
+void animate_screen(void) {
+    const double start = frame_stats_now();
+    const double detect = gol_cycle_seconds();
+    gol_update();
+    const double detected = gol_cycle_seconds() - detect;
+    frame_stats_record(FRAME_STAGE_SIMULATE, frame_stats_now() - start - detected);
+    frame_stats_record(FRAME_STAGE_DETECT, detected);
+    render_frame();
+    present_frame(present_active());
+    frame_stats_frame(start, frame_stats_now());
 }
 
 /*
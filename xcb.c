@@ -11,6 +11,7 @@
 #include <xcb/xcb_image.h>
 #include <xcb/xcb_atom.h>
 #include <xcb/xcb_aux.h>
+#include <xcb/shm.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -20,8 +21,11 @@
 #include <err.h>
 #include <time.h>
 #include <sys/time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
 #include "cursors.h"
+#include "xcb.h"
 #include "unlock_indicator.h"
 
 extern auth_state_t auth_state;
@@ -124,6 +128,149 @@ xcb_pixmap_t create_bg_pixmap(xcb_connection_t *conn, xcb_screen_t *scr, u_int32
     return bg_pixmap;
 }
 
+/*
+ * Returns true if the pixels of the root window can be written as native
+ * 32 bit 0x00RRGGBB values, which is what a client-side frame buffer holds.
+ *
+ */
+bool visual_is_rgb24(xcb_connection_t *conn, xcb_screen_t *scr) {
+    xcb_visualtype_t *visual = get_root_visual_type(scr);
+    if (visual == NULL ||
+        visual->_class != XCB_VISUAL_CLASS_TRUE_COLOR ||
+        visual->red_mask != 0xff0000 ||
+        visual->green_mask != 0x00ff00 ||
+        visual->blue_mask != 0x0000ff) {
+        return false;
+    }
+
+    const xcb_setup_t *setup = xcb_get_setup(conn);
+    const uint16_t endianness = 1;
+    const uint8_t native_order = (*(const uint8_t *)&endianness == 1 ? XCB_IMAGE_ORDER_LSB_FIRST : XCB_IMAGE_ORDER_MSB_FIRST);
+    if (setup->image_byte_order != native_order) {
+        return false;
+    }
+
+    for (xcb_format_iterator_t format_iter = xcb_setup_pixmap_formats_iterator(setup);
+         format_iter.rem;
+         xcb_format_next(&format_iter)) {
+        if (format_iter.data->depth == scr->root_depth) {
+            return (format_iter.data->bits_per_pixel == 32);
+        }
+    }
+    return false;
+}
+
+/*
+ * Uploads a rectangle of a client-side 32 bit frame buffer (see
+ * visual_is_rgb24()) onto the drawable. Rows narrower than the buffer are
+ * packed first, and the upload is split into as many PutImage requests as
+ * the maximum request length needs.
+ *
+ */
+void put_pixels(xcb_connection_t *conn, xcb_drawable_t drawable, xcb_gcontext_t gc, uint8_t depth,
+                const uint32_t *pixels, int stride, xcb_rectangle_t rect) {
+    static uint32_t *packed = NULL;
+    static size_t packed_size = 0;
+
+    if (rect.width == 0 || rect.height == 0) {
+        return;
+    }
+
+    /* Leave room for the request header. */
+    const size_t max_bytes = (xcb_get_maximum_request_length(conn) * 4) - 64;
+    const size_t row_bytes = rect.width * sizeof(uint32_t);
+    int band = (max_bytes / row_bytes > 0 ? max_bytes / row_bytes : 1);
+    if (band > rect.height) {
+        band = rect.height;
+    }
+
+    for (int y = 0; y < rect.height; y += band) {
+        const int rows = (rect.height - y < band ? rect.height - y : band);
+        const uint32_t *src = pixels + ((size_t)(rect.y + y) * stride) + rect.x;
+        if (rect.width != stride) {
+            if (packed_size < row_bytes * band) {
+                packed_size = row_bytes * band;
+                packed = realloc(packed, packed_size);
+                if (packed == NULL) {
+                    err(EXIT_FAILURE, "realloc");
+                }
+            }
+            for (int row = 0; row < rows; row++) {
+                memcpy(packed + ((size_t)row * rect.width), src + ((size_t)row * stride), row_bytes);
+            }
+            src = packed;
+        }
+
+        xcb_image_t *image = xcb_image_create_native(conn, rect.width, rows, XCB_IMAGE_FORMAT_Z_PIXMAP, depth,
+                                                     NULL, row_bytes * rows, (uint8_t *)src);
+        if (image == NULL) {
+            return;
+        }
+        xcb_image_put(conn, drawable, gc, image, rect.x, rect.y + y, 0);
+        xcb_image_destroy(image);
+    }
+}
+
+/*
+ * Creates a shared memory segment of the given size and attaches it to the X
+ * server (MIT-SHM). Returns false if the extension is missing or the server
+ * cannot attach it, e.g. because it runs on another machine.
+ *
+ */
+bool shm_segment_create(xcb_connection_t *conn, size_t size, struct shm_segment *segment) {
+    const xcb_query_extension_reply_t *extension = xcb_get_extension_data(conn, &xcb_shm_id);
+    if (extension == NULL || !extension->present) {
+        return false;
+    }
+
+    int shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (shmid == -1) {
+        return false;
+    }
+    void *addr = shmat(shmid, NULL, 0);
+    if (addr == (void *)-1) {
+        shmctl(shmid, IPC_RMID, NULL);
+        return false;
+    }
+
+    xcb_shm_seg_t seg = xcb_generate_id(conn);
+    xcb_generic_error_t *error = xcb_request_check(conn, xcb_shm_attach_checked(conn, seg, shmid, 0));
+    /* The segment is gone as soon as both sides detach it, even if i3lock
+     * crashes. */
+    shmctl(shmid, IPC_RMID, NULL);
+    if (error != NULL) {
+        free(error);
+        shmdt(addr);
+        return false;
+    }
+
+    segment->seg = seg;
+    segment->addr = addr;
+    return true;
+}
+
+void shm_segment_destroy(xcb_connection_t *conn, struct shm_segment *segment) {
+    xcb_shm_detach(conn, segment->seg);
+    shmdt(segment->addr);
+    segment->addr = NULL;
+}
+
+/*
+ * Copies a rectangle of a 32 bit frame buffer living in a shared memory
+ * segment onto the drawable. The X server reads the pixels straight from the
+ * segment, so they must not change until it processed the request.
+ *
+ */
+void shm_put_pixels(xcb_connection_t *conn, xcb_drawable_t drawable, xcb_gcontext_t gc, uint8_t depth,
+                    struct shm_segment *segment, int stride, int height, xcb_rectangle_t rect) {
+    xcb_shm_put_image(conn, drawable, gc,
+                      stride, height,
+                      rect.x, rect.y, rect.width, rect.height,
+                      rect.x, rect.y,
+                      depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0,
+                      segment->seg, 0);
+}
+
 xcb_window_t open_fullscreen_window(xcb_connection_t *conn, xcb_screen_t *scr, char *color, xcb_pixmap_t pixmap) {
     uint32_t mask = 0;
     uint32_t values[3];